@@ -7,6 +7,7 @@
 /* bitmap.c contains the code that handles the inode and block bitmaps */
 /* bitmap.c程序含有处理i节点和磁盘块位图的代码 */
 #include <string.h>
+#include <sys/stat.h>
 #include <linux/sched.h>							// 调度程序头文件,定义任务结构task_struct,任务0数据.
 #include <linux/kernel.h>
 
@@ -61,6 +62,80 @@ __asm__(\
 	:"=c" (__res):"c" (0), "S" (addr):"ax", "dx"); \
 __res;})
 
+/*
+ * Zones are allocated close to a goal, normally the block after the
+ * previous block of the same file, so that files stay contiguous. The
+ * superblock keeps the number of free zones and a hint below which
+ * there are no free zones, so we don't scan the bitmap from the start
+ * every time. Bit n of the zone bitmap is zone n + s_firstdatazone - 1.
+ *
+ * The search goes outward from the goal: if the goal itself is taken,
+ * the nearest free zone after it is used, unless there is a closer one
+ * within NEAR zones before it.
+ */
+/*
+ * 分配逻辑块时尽量靠近目标块,目标块通常是同一文件前一块之后的那一块,这样文件就能保持连续.超级块中保存着空闲逻辑块数以及一个
+ * 提示位置,在它之前没有空闲逻辑块,这样就不必每次都从头扫描位图.逻辑块位图中的第n位对应逻辑块n + s_firstdatazone - 1.
+ *
+ * 搜索从目标块向两边进行:若目标块已被使用,就用其后最近的空闲块,除非在目标块之前NEAR块以内有更近的空闲块.
+ */
+#define NEAR	64
+// 从逻辑块位图的第bit位开始向后寻找第一个0值位.返回其位号,没有则返回-1.
+static int find_next_zero_zone(struct super_block * sb, int bit)
+{
+	int nbits = sb->s_nzones - sb->s_firstdatazone + 1;
+	unsigned long w;
+	int i;
+
+	while (bit < nbits) {
+		if (!sb->s_zmap[bit >> 13])
+			return -1;
+		w = ~((unsigned long *) sb->s_zmap[bit >> 13]->b_data)[(bit & 8191) >> 5];
+		w >>= bit & 31;
+		if (w) {
+			__asm__("bsfl %1, %0":"=r" (i):"r" (w));
+			bit += i;
+			return bit < nbits ? bit : -1;
+		}
+		bit = (bit | 31) + 1;
+	}
+	return -1;
+}
+
+// 从逻辑块位图的第bit位开始向前(向低位)寻找第一个0值位,但不低于第low位.返回其位号,没有则返回-1.
+static int find_prev_zero_zone(struct super_block * sb, int bit, int low)
+{
+	unsigned long w;
+	int i;
+
+	while (bit >= low && bit >= 0) {
+		if (!sb->s_zmap[bit >> 13])
+			return -1;
+		w = ~((unsigned long *) sb->s_zmap[bit >> 13]->b_data)[(bit & 8191) >> 5];
+		w <<= 31 - (bit & 31);
+		if (w) {
+			__asm__("bsrl %1, %0":"=r" (i):"r" (w));
+			bit -= 31 - i;
+			return bit >= low ? bit : -1;
+		}
+		bit = (bit & ~31) - 1;
+	}
+	return -1;
+}
+
+// 统计文件系统的空闲逻辑块数,并设置分配提示.在读入超级块时调用(fs/super.c).
+void count_free_zones(struct super_block * sb)
+{
+	int bit;
+
+	sb->s_zfree = 0;
+	sb->s_zhint = find_next_zero_zone(sb, 0);
+	if (sb->s_zhint < 0)
+		sb->s_zhint = sb->s_nzones;
+	for (bit = sb->s_zhint; (bit = find_next_zero_zone(sb, bit)) >= 0; bit++)
+		sb->s_zfree++;
+}
+
 // 释放设备dev上数据区中的逻辑块block。
 // 复位指定逻辑块block对应的逻辑块位图位。成功则返回1,否则返回0.
 // 参数：dev是设备号，block是逻辑块号（盘块号）。
@@ -97,55 +172,127 @@ int free_block(int dev, int block)
 	if (clear_bit(block & 8191, sb->s_zmap[block / 8192]->b_data)) {
 		printk("block (%04x:%d) ", dev, block + sb->s_firstdatazone - 1);
 		printk("free_block: bit already cleared\n");
+	} else {
+		sb->s_zfree++;
+		if (block < sb->s_zhint)
+			sb->s_zhint = block;
 	}
 	// 最后置相应逻辑块位图所在缓冲区已修改标志。
 	sb->s_zmap[block / 8192]->b_dirt = 1;
 	return 1;
 }
 
+// 在高速缓冲区中为设备dev上新分配的逻辑块block取得一个缓冲块.因为刚取得的逻辑块其引用次数一定为1(getblk()中会设置),
+// 因此若不为1则停机.然后将其清零,并设置其已更新标志和已修改标志,最后释放该缓冲块.
+static void zero_zone(int dev, int block)
+{
+	struct buffer_head * bh;
+
+	if (!(bh = getblk(dev, block)))
+		panic("new_block: cannot get block");
+	if (bh->b_count != 1)
+		panic("new block: count is != 1");
+	clear_block(bh->b_data);
+	bh->b_uptodate = 1;
+	bh->b_dirt = 1;
+	brelse(bh);
+}
+
 // 向设备申请一个逻辑块(盘块,区块).
 // 函数首先取得设备的超级块,并在超级块中的逻辑块位图中寻找第一个0值位(代表一个空闲逻辑块).然后置位对应逻辑块在逻辑位图
 // 中的位.接着为该逻辑块在缓冲区中取得一块对应缓冲块.最后将该缓冲块清零,并设置其已更新标志和已修改标志.并返回逻辑块号.
 // 函数执行成功则返回逻辑块号(盘块号),否则返回0.
-int new_block(int dev)
+int new_block(int dev, int goal)
 {
-	struct buffer_head * bh;
 	struct super_block * sb;
-	int i,j;
+	int j = -1, bit, k;
 
-	// 首先获取设备dev的超级块.如果指定设备的超级块不存在,则出错停机.然后扫描文件系统的8块逻辑块位图,寻找首个0值位,以寻找
-	// 空闲逻辑块,获取设置该逻辑块的块号.如果全部扫描完8块逻辑块位图的所有位(i >=8 或 j >= 8192)还没有找到0值位或者位图
-	// 所在的缓冲块指针无效(bn = NULL)则返回0退出(没有空闲逻辑块).
+	// 首先获取设备dev的超级块.如果指定设备的超级块不存在,则出错停机.若已没有空闲逻辑块则直接返回0.
 	if (!(sb = get_super(dev)))
 		panic("trying to get new block from nonexistant device");
-	j = 8192;
-	for (i = 0 ; i < 8 ; i++)
-		if (bh = sb->s_zmap[i])
-			if ((j = find_first_zero(bh->b_data)) < 8192)
-				break;
-	if (i >= 8 || !bh || j >= 8192)
+	if (!sb->s_zfree)
 		return 0;
-	// 接着设置找到的新逻辑块j对应逻辑块位图中的位.若对应位已经置位,则出错停机.否则置存在位图的对应缓冲区块已修改标志.因为
-	// 逻辑块位图仅表示盘上数据区中逻辑块的占用情况,即逻辑块位图中位偏移值表示从数据区开始处算起的块号,因此这里需要加上数据
-	// 区第1个逻辑块的块号,把j转换成逻辑块号.此时如果新逻辑块大于该设备上的总逻辑块数,则说明指定逻辑块在对应设备上不存在.
-	// 申请失败,返回0退出.
-	if (set_bit(j, bh->b_data))
-		panic("new_block: bit already set");
-	bh->b_dirt = 1;
-	j += i * 8192 + sb->s_firstdatazone - 1;
-	if (j >= sb->s_nzones)
+	// 先从目标块开始向后找空闲块,若目标块已被使用,再在目标块之前NEAR块以内找,取离目标块较近的一个;若没有目标块或两边都没找到,
+	// 再从提示位置开始找.从提示位置找到的就是第一个空闲块.
+	if (goal >= sb->s_firstdatazone && goal < sb->s_nzones) {
+		bit = goal - sb->s_firstdatazone + 1;
+		j = find_next_zero_zone(sb, bit);
+		if (j != bit && (k = find_prev_zero_zone(sb, bit - 1, bit - NEAR)) >= 0 &&
+		    (j < 0 || bit - k < j - bit))
+			j = k;
+	}
+	if (j < 0 && (j = find_next_zero_zone(sb, sb->s_zhint)) >= 0)
+		sb->s_zhint = j;
+	if (j < 0)
 		return 0;
-	// 然后在高速缓冲区中为该设备上指定的逻辑块号取得一个缓冲块,并返回缓冲块头指针.
-	// 因为刚取得的逻辑块其引用次数一定为1(getblk()中会设置),因此若不为1则停机.最后将新逻辑块清零,并设置其已更新标志和已
-	// 修改标志.然后释放对应缓冲块,返回逻辑块号.
-	if (!(bh = getblk(dev, j)))
-		panic("new_block: cannot get block");
-	if (bh->b_count != 1)
-		panic("new block: count is != 1");
-	clear_block(bh->b_data);
-	bh->b_uptodate = 1;
-	bh->b_dirt = 1;
-	brelse(bh);
+	// 接着设置找到的位,更新空闲块数和提示位置,并把位号转换成逻辑块号.
+	if (set_bit(j & 8191, sb->s_zmap[j >> 13]->b_data))
+		panic("new_block: bit already set");
+	sb->s_zmap[j >> 13]->b_dirt = 1;
+	sb->s_zfree--;
+	if (j == sb->s_zhint)
+		sb->s_zhint++;
+	j += sb->s_firstdatazone - 1;
+	// 最后为新逻辑块取得一个清零的缓冲块,返回逻辑块号.
+	zero_zone(dev, j);
+	return j;
+}
+
+/*
+ * Regular files get PREALLOC zones reserved after each zone that had
+ * to be searched for. The reserved zones are marked in the bitmap, so
+ * other files - or a concurrent writer of another file - allocate
+ * around them, and a file written sequentially ends up contiguous.
+ * Reservations are given back when the file is truncated, when the
+ * last reference is dropped, or when a write goes somewhere else.
+ */
+/*
+ * 普通文件每次需要搜索分配一个逻辑块时,就在其后预留PREALLOC个逻辑块.预留的块在位图中已置位,因此别的文件(或同时在写的
+ * 另一个文件)会绕开它们分配,顺序写的文件就能保持连续.文件被截断,最后一个引用被释放,或者写到了别处时,就归还预留的块.
+ */
+#define PREALLOC	8
+
+// 释放i节点预留的逻辑块.free_block()可能睡眠,所以先清除i节点中的预留记录.
+void free_prealloc(struct m_inode * inode)
+{
+	int block = inode->i_prealloc_block;
+	int count = inode->i_prealloc_count;
+
+	inode->i_prealloc_count = 0;
+	while (count--)
+		free_block(inode->i_dev, block++);
+}
+
+// 为文件inode申请一个尽量靠近goal的逻辑块.若goal正好是预留的下一块,就直接使用它;否则归还预留的块,重新申请一块,并预留其后
+// 连续的空闲块.由fs/inode.c中的_bmap()调用.
+int new_file_block(struct m_inode * inode, int goal)
+{
+	struct super_block * sb;
+	int j, bit;
+
+	if (inode->i_prealloc_count) {
+		if (goal == inode->i_prealloc_block) {
+			j = inode->i_prealloc_block++;
+			inode->i_prealloc_count--;
+			zero_zone(inode->i_dev, j);
+			return j;
+		}
+		free_prealloc(inode);
+	}
+	if (!(j = new_block(inode->i_dev, goal)) || !S_ISREG(inode->i_mode))
+		return j;
+	// 预留紧跟在新块后面的空闲块,遇到已使用的块就停止.
+	if (!(sb = get_super(inode->i_dev)))
+		return j;
+	inode->i_prealloc_block = j + 1;
+	bit = j + 1 - (sb->s_firstdatazone - 1);
+	while (inode->i_prealloc_count < PREALLOC && find_next_zero_zone(sb, bit) == bit) {
+		set_bit(bit & 8191, sb->s_zmap[bit >> 13]->b_data);
+		sb->s_zmap[bit >> 13]->b_dirt = 1;
+		sb->s_zfree--;
+		inode->i_prealloc_count++;
+		bit++;
+	}
 	return j;
 }
 
@@ -163,7 +310,7 @@ void free_inode(struct m_inode * inode)
 	if (!inode)
 		return;
 	if (!inode->i_dev) {
-		memset(inode, 0, sizeof(*inode));
+		clear_inode(inode);
 		return;
 	}
 	// 如果此i节点还有其他程序引用，则不释放，说明内核有问题，停机。如果文件连接数不为0,则表示还有其他文件目录项在使用该节点，
@@ -189,7 +336,7 @@ void free_inode(struct m_inode * inode)
 	if (clear_bit(inode->i_num & 8191, bh->b_data))
 		printk("free_inode: bit already cleared.\n\r");
 	bh->b_dirt = 1;
-	memset(inode, 0, sizeof(*inode));
+	clear_inode(inode);
 }
 
 // 为设备dev建立一个新i节点。初始化并返回该新i节点的指针。
@@ -229,6 +376,7 @@ struct m_inode * new_inode(int dev)
 	inode->i_gid = current->egid;     										// 组id。
 	inode->i_dirt = 1;                										// 已修改标志置位。
 	inode->i_num = j + i * 8192;      										// 对应设备中的i节点号。
+	insert_into_ihash(inode);
 	inode->i_mtime = inode->i_atime = inode->i_ctime = CURRENT_TIME;        // 设置时间。
 	return inode;                   										// 返回该i节点指针。
 }
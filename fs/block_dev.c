@@ -60,15 +60,16 @@ int block_write(int dev, long * pos, char * buf, int count)
 		// 接着先把指针p指向读出数据的缓冲块中开始写入数据的位置处。若最后一次循环写入的数据不足一块，则需要从块开始
 		// 处填写（修改）所需的字节，因此这里需预先设置offset为零。此后将文件中偏移指针pos前移此次将要写的字节数chars
 		// 并累加这些要写的字节数到统计值written中。再把还需要写的计数值count减去此次要写的字节数chars。然后我们从
-		// 用户缓冲区复制chars个字节到p指向的高速缓冲块中开始写入的位置处。复制完后就设置该缓冲区块已修改标志，并释放
-		// 该缓冲区（即该缓冲区引用计数递减1）。
+		// 用户缓冲区复制chars个字节到p指向的高速缓冲块中开始写入的位置处。复制完后就设置该缓冲区块已更新和已修改标志
+		// (整块写入时缓冲块是直接取得的,没有从设备读入),并释放该缓冲区（即该缓冲区引用计数递减1）。
 		p = offset + bh->b_data;
 		offset = 0;
 		*pos += chars;
 		written += chars;               						// 累计写入字节数。
 		count -= chars;
-		while (chars-- > 0)
-			*(p++) = get_fs_byte(buf++);
+		memcpy_fromfs(p, buf, chars);
+		buf += chars;
+		bh->b_uptodate = 1;
 		bh->b_dirt = 1;
 		brelse(bh);
 	}
@@ -118,8 +119,8 @@ int block_read(int dev, unsigned long * pos, char * buf, int count)
 		*pos += chars;
 		read += chars;                  						// 累计读入字节数。
 		count -= chars;
-		while (chars-- > 0)
-			put_fs_byte(*(p++), buf++);
+		memcpy_tofs(buf, p, chars);
+		buf += chars;
 		brelse(bh);
 	}
 	return read;                            					// 返回已读取的字节数，正常退出。
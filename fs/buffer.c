@@ -26,12 +26,15 @@
  */
 
 #include <stdarg.h>
+#include <errno.h>
 
 //#include <linux/config.h>
 #include <linux/sched.h>
 #include <linux/fs.h>
 //#include <linux/kernel.h>
+#include <sys/stat.h>
 #include <asm/system.h>
+#include <asm/segment.h>
 //#include <asm/io.h>
 
 // 变量end是由编译时的连接程序ld生成,用于表明内核代码的末端,即指明内核模块末端位置.也可以从编译时生成的System.map文件中查出.这里用它
@@ -41,14 +44,43 @@
 // 使用的等待队列头指针.
 extern int end;
 struct buffer_head * start_buffer = (struct buffer_head *) &end;
-struct buffer_head * hash_table[NR_HASH];							// NR_HASH = 307项.
-static struct buffer_head * free_list;								// 空闲缓冲块链表头指针.
+struct buffer_head ** hash_table;									// hash表,共NR_HASH项,在buffer_init()中分配.
+// 空闲缓冲块LRU链表头指针数组.引用计数为0的缓冲块按状态挂在BUF_CLEAN,BUF_LOCKED和BUF_DIRTY三个双向循环链表中,
+// 链表头是最久未使用(LRU)的一块,其b_prev_free则是最近释放(MRU)的一块.正被使用(b_count>0)的缓冲块不在任何链表中.
+static struct buffer_head * lru_list[NR_LIST] = { NULL, };
+struct buffer_stat buffer_stat = { 0, };							// 高速缓冲统计信息.
 static struct task_struct * buffer_wait = NULL;						// 等待空闲缓冲块而睡眠的任务队列.
+static struct task_struct * bdflush_task = NULL;					// 缓冲回写任务(执行bdflush(0)的进程).
+static struct task_struct * bdflush_wait = NULL;					// 回写任务在此睡眠等待下一次刷新.
+
+// 缓冲回写任务的可调参数,可以通过系统调用bdflush()在运行时读取和修改.
+#define N_PARAM 4
+
+static union bdflush_param {
+	struct {
+		int nfract;		/* 已修改块占缓冲块总数的百分比超过此值时立即回写 */
+		int ndirty;		/* 每次刷新最多写出的块数 */
+		int interval;	/* 两次定时刷新的间隔(滴答数) */
+		int age_buffer;	/* 已修改块在被写出之前最多保留的时间(滴答数) */
+	} b_un;
+	int data[N_PARAM];
+} bdf_prm = {{25, 64, 5 * HZ, 30 * HZ}};
+
+// 各参数允许的最小值和最大值.
+static int bdflush_min[N_PARAM] = {  0,   1,        HZ / 10,       HZ / 10 };
+static int bdflush_max[N_PARAM] = {100, 1000, 600 * HZ, 600 * HZ };
+
+// 判断LRU链表中已修改的缓冲块是否过多.
+#define TOO_MANY_DIRTY() \
+	(buffer_stat.bs_nr_free[BUF_DIRTY] * 100 > bdf_prm.b_un.nfract * NR_BUFFERS)
 // 下面定义系统缓冲区中含有的缓冲块个数.这里,NR_BUFFERS是一个定义在linux/fs.h头文件的宏,其值即是变量名nr_buffers,并且在fs.h文件声明
 // 为全局变量.
 // 大写名称通常都是一个宏名称,Linus这样编写代码是为了利用这个大写名称来隐含地表示nr_buffers是一个在内核初始化之后不再改变的"常量".它将在
 // 初始化函数buffer_init()中被设置.
 int NR_BUFFERS = 0;													// 系统含有缓冲块个数.
+// hash表项数和对应的位数(NR_HASH = 1 << hash_bits),在buffer_init()中根据缓冲块数目确定.
+int NR_HASH = 0;
+static int hash_bits = 0;
 
 // 等待指定缓冲块解锁.
 // 如果指定的缓冲块bh已经上锁就让进程不可中断地睡眠在该缓冲块的等待队列b_wait中.在缓冲块解锁时,其等待队列上的所有进程将被唤醒.虽然是在关闭
@@ -78,6 +110,167 @@ int sys_sync(void)
 		if (bh->b_dirt)
 			ll_rw_block(WRITE, bh);  		// 产生写设备块请求。
 	}
+	// 最后对每个已安装文件系统的设备发出屏障请求，等待上面的写操作完成并刷新驱动器的写缓存。
+	for (i = 0 ; i < NR_SUPER ; i++)
+		if (super_block[i].s_dev)
+			ll_rw_flush(super_block[i].s_dev);
+	return 0;
+}
+
+/*
+ * Buffers dirtied through a file - its data blocks and indirect blocks,
+ * see file_write() and _bmap() - are kept on a list hanging off the
+ * in-core inode, so fsync() can write just those instead of scanning
+ * the whole cache. Buffers are never taken off the list when they are
+ * written (that happens at interrupt time); clean ones are dropped by
+ * fsync(), when the buffer is reused for another block, or when the
+ * inode is cleared.
+ */
+/*
+ * 通过文件修改的缓冲块 -- 文件的数据块和间接块,参见file_write()和_bmap() -- 都挂在内存i节点的一个链表上,这样fsync()只需写出这些块,
+ * 而不必扫描整个高速缓冲.块被写盘时(在中断中完成)并不从链表中取下;干净的块由fsync()取下,或者在缓冲块被用于其他块时,或者在i节点
+ * 被清空时取下.
+ */
+// 从所属i节点的缓冲块链表中取下缓冲块.
+static inline void remove_from_inode_list(struct buffer_head * bh)
+{
+	if (!bh->b_inode)
+		return;
+	if (bh->b_inode_next)
+		bh->b_inode_next->b_inode_prev = bh->b_inode_prev;
+	if (bh->b_inode_prev)
+		bh->b_inode_prev->b_inode_next = bh->b_inode_next;
+	else
+		bh->b_inode->i_buffers = bh->b_inode_next;
+	bh->b_inode = NULL;
+	bh->b_inode_next = bh->b_inode_prev = NULL;
+}
+
+// 置缓冲块已修改标志,并把它挂到文件inode的缓冲块链表上.虚拟盘块不需要写盘,所以不挂.
+void mark_buffer_dirty(struct buffer_head * bh, struct m_inode * inode)
+{
+	bh->b_dirt = 1;
+	if (bh->b_inode == inode || bh->b_list == BUF_RAMDISK)
+		return;
+	remove_from_inode_list(bh);
+	bh->b_inode = inode;
+	if ((bh->b_inode_next = inode->i_buffers))
+		bh->b_inode_next->b_inode_prev = bh;
+	inode->i_buffers = bh;
+}
+
+// 取下挂在i节点上的所有缓冲块.在i节点被清空或重用之前调用(fs/inode.c中的clear_inode(),get_empty_inode()和invalidate_inodes()).
+void invalidate_inode_buffers(struct m_inode * inode)
+{
+	while (inode->i_buffers)
+		remove_from_inode_list(inode->i_buffers);
+}
+
+// 写出挂在i节点上的已修改缓冲块,并等待写操作完成.ll_rw_block()可能睡眠,其间缓冲块可能被重用而离开链表,这时就从头开始.最后取下
+// 已经干净的块.fsync()和get_empty_inode()重用i节点之前都要调用.
+void sync_inode_buffers(struct m_inode * inode)
+{
+	struct buffer_head * bh, * next;
+
+repeat:
+	for (bh = inode->i_buffers ; bh ; bh = bh->b_inode_next) {
+		if (bh->b_lock || !bh->b_dirt)
+			continue;
+		ll_rw_block(WRITE, bh);
+		if (bh->b_inode != inode)
+			goto repeat;
+	}
+wait:
+	for (bh = inode->i_buffers ; bh ; bh = bh->b_inode_next)
+		if (bh->b_lock) {
+			wait_on_buffer(bh);
+			goto wait;
+		}
+	for (bh = inode->i_buffers ; bh ; bh = next) {
+		next = bh->b_inode_next;
+		if (!bh->b_dirt)
+			remove_from_inode_list(bh);
+	}
+}
+
+// 把文件的数据和i节点写到设备上。datasync非0时(fdatasync())只写数据,以及为找到数据所必需的i节点内容(文件长度和块映射),
+// 否则(fsync())还要写出设备的位图块。最后发出屏障请求，返回时数据已确实写到盘上。目录的缓冲块没有记在i节点名下，所以仍然同步
+// 整个设备。只有普通文件和目录可以同步。
+static int do_fsync(unsigned int fd, int datasync)
+{
+	struct file * file;
+	struct m_inode * inode;
+	struct super_block * sb;
+	struct buffer_head * bh;
+	int i;
+
+	if (fd >= NR_OPEN || !(file = current->filp[fd]) || !(inode = file->f_inode))
+		return -EBADF;
+	if (!S_ISREG(inode->i_mode) && !S_ISDIR(inode->i_mode))
+		return -EINVAL;
+	if (S_ISDIR(inode->i_mode)) {
+		sync_dev(inode->i_dev);
+		return 0;
+	}
+	sync_inode_buffers(inode);
+	fsync_inode(inode, datasync);								// fs/inode.c
+	if (!datasync && (sb = get_super(inode->i_dev))) {
+		for (i = 0 ; i < I_MAP_SLOTS ; i++)
+			if ((bh = sb->s_imap[i]) && bh->b_dirt)
+				ll_rw_block(WRITE, bh);
+		for (i = 0 ; i < Z_MAP_SLOTS ; i++)
+			if ((bh = sb->s_zmap[i]) && bh->b_dirt)
+				ll_rw_block(WRITE, bh);
+		for (i = 0 ; i < I_MAP_SLOTS ; i++)
+			if (bh = sb->s_imap[i])
+				wait_on_buffer(bh);
+		for (i = 0 ; i < Z_MAP_SLOTS ; i++)
+			if (bh = sb->s_zmap[i])
+				wait_on_buffer(bh);
+	}
+	ll_rw_flush(inode->i_dev);
+	return 0;
+}
+
+// 系统调用fsync()：把文件的数据和i节点写到设备上。
+int sys_fsync(unsigned int fd)
+{
+	return do_fsync(fd, 0);
+}
+
+// 系统调用fdatasync()：把文件的数据写到设备上，只有在文件长度或块映射改变时才写i节点。
+int sys_fdatasync(unsigned int fd)
+{
+	return do_fsync(fd, 1);
+}
+
+// 取高速缓冲统计信息。
+// 把统计结构buffer_stat复制到用户空间stat处。成功返回0。
+int sys_bufstat(struct buffer_stat * stat)
+{
+	struct buffer_head * bh;
+	int i, n;
+
+	if (!stat)
+		return -EINVAL;
+	// hash链长度统计在这里临时计算.
+	buffer_stat.bs_hash_size = NR_HASH;
+	buffer_stat.bs_hash_used = 0;
+	buffer_stat.bs_hash_entries = 0;
+	buffer_stat.bs_hash_maxchain = 0;
+	for (i = 0 ; i < NR_HASH ; i++) {
+		for (n = 0, bh = hash_table[i] ; bh ; bh = bh->b_next)
+			n++;
+		if (!n)
+			continue;
+		buffer_stat.bs_hash_used++;
+		buffer_stat.bs_hash_entries += n;
+		if (n > buffer_stat.bs_hash_maxchain)
+			buffer_stat.bs_hash_maxchain = n;
+	}
+	verify_area(stat, sizeof *stat);
+	for (i = 0; i < sizeof *stat; i++)
+		put_fs_byte(((char *) &buffer_stat)[i], i + (char *) stat);
 	return 0;
 }
 
@@ -114,6 +307,8 @@ int sync_dev(int dev)
 		if (bh->b_dev == dev && bh->b_dirt)
 			ll_rw_block(WRITE, bh);
 	}
+	// 最后发出屏障请求，等待写操作完成并把驱动器写缓存中的数据写到盘上。
+	ll_rw_flush(dev);
 	return 0;
 }
 
@@ -180,14 +375,67 @@ void check_disk_change(int dev)
 
 // 下面两行代码是hash(散列)函数定义和hash表项的计算宏.
 // hash表的主要作用是减少查找比较元素所花费的时间.通过在元素的存储位置与关键字之间建立一个对应关系(hash函数),我们就可以直接通过函数计算立刻
-// 查询到指定的元素.建立hash函数的指导条件主要是尽量确保散列到任何数组项的概率基本相等.建立函数的方法有多种,这里Linux0.12主要采用了关键字除
-// 余数法.因为我们寻找的缓冲块有两个条件,即设备号dev和缓冲块号block,因此设计的hash函数肯定需要包含这两个关键值.这里两个关键字的异或操作只是
-// 计算关键值的一种方法.再对关键值进行MOD运算就可以保证函数计算得到的值都处于函数数组项范围内.
-#define _hashfn(dev, block) (((unsigned)(dev ^ block)) % NR_HASH)
+// 查询到指定的元素.建立hash函数的指导条件主要是尽量确保散列到任何数组项的概率基本相等.原来的hash函数是(dev ^ block) % 307,相邻块号与
+// 设备号异或后仍然相邻,而且除法运算较慢.这里采用乘法散列:先把设备号移到块号之上的高位与块号合并成一个关键值,再乘以黄金分割常数
+// 2654435761(约等于2^32 * 0.618),取乘积的高hash_bits位作为表项索引.这样关键值的每一位都会影响结果,而表的大小则可以是任意的2的幂.
+#define _hashfn(dev, block) \
+	((((unsigned long) (block) ^ ((unsigned long) (dev) << 16)) * 2654435761UL) >> (32 - hash_bits))
 #define hash(dev, block) hash_table[_hashfn(dev, block)]
 
-// 从hash队列和空闲缓冲队列中移走缓冲块.
-// hash队列是双向链表结构,空闲缓冲块队列是双向循环链表结构.
+// 根据缓冲块当前的锁定和修改标志计算它应该所在的LRU链表.
+#define BUF_LIST(bh) ((bh)->b_lock ? BUF_LOCKED : ((bh)->b_dirt ? BUF_DIRTY : BUF_CLEAN))
+
+// 从所在的LRU链表中移走缓冲块.
+static inline void remove_from_lru(struct buffer_head * bh)
+{
+	struct buffer_head ** head = lru_list + bh->b_list;
+
+	if (!(bh->b_prev_free) || !(bh->b_next_free))
+		panic("Free block list corrupted");
+	bh->b_prev_free->b_next_free = bh->b_next_free;
+	bh->b_next_free->b_prev_free = bh->b_prev_free;
+	// 如果链表头指向本缓冲块,则让其指向下一块;若本块是链表中唯一的一块,则链表变空.
+	if (*head == bh)
+		*head = (bh->b_next_free == bh) ? NULL : bh->b_next_free;
+	bh->b_prev_free = bh->b_next_free = NULL;
+	buffer_stat.bs_nr_free[bh->b_list]--;
+}
+
+// 按缓冲块当前状态将其插入相应LRU链表的尾部(MRU端).
+static inline void insert_into_lru(struct buffer_head * bh)
+{
+	struct buffer_head ** head;
+
+	bh->b_list = BUF_LIST(bh);
+	// 记录缓冲块第一次进入已修改链表的时刻,回写任务据此按块的"年龄"写盘.
+	if (bh->b_list != BUF_DIRTY)
+		bh->b_flushtime = 0;
+	else if (!bh->b_flushtime)
+		bh->b_flushtime = jiffies + bdf_prm.b_un.age_buffer;
+	head = lru_list + bh->b_list;
+	buffer_stat.bs_nr_free[bh->b_list]++;
+	if (!*head) {
+		*head = bh->b_prev_free = bh->b_next_free = bh;
+		return;
+	}
+	bh->b_next_free = *head;
+	bh->b_prev_free = (*head)->b_prev_free;
+	(*head)->b_prev_free->b_next_free = bh;
+	(*head)->b_prev_free = bh;
+}
+
+// 缓冲块的状态在它位于链表中时可能已经改变(例如I/O完成后解锁,或被sync操作写盘后变干净),此时把它移到正确的链表中.
+static inline void refile_buffer(struct buffer_head * bh)
+{
+	if (bh->b_list == BUF_LIST(bh))
+		return;
+	remove_from_lru(bh);
+	insert_into_lru(bh);
+	buffer_stat.bs_refiles++;
+}
+
+// 从hash队列和空闲LRU链表中移走缓冲块.
+// hash队列是双向链表结构,LRU链表是双向循环链表结构.只有引用计数为0的缓冲块才位于LRU链表中.
 static inline void remove_from_queues(struct buffer_head * bh)
 {
 	/* remove from hash-queue */
@@ -201,24 +449,14 @@ static inline void remove_from_queues(struct buffer_head * bh)
 		hash(bh->b_dev, bh->b_blocknr) = bh->b_next;
 	/* remove from free list */
 	/* 从空闲缓冲块表中移除缓冲块 */
-	if (!(bh->b_prev_free) || !(bh->b_next_free))
-		panic("Free block list corrupted");
-	bh->b_prev_free->b_next_free = bh->b_next_free;
-	bh->b_next_free->b_prev_free = bh->b_prev_free;
-	// 如果空闲链表头指向本缓冲区,则让其指向下一缓冲区.
-	if (free_list == bh)
-		free_list = bh->b_next_free;
+	if (bh->b_prev_free)
+		remove_from_lru(bh);
 }
 
-// 将缓冲块插入空闲链表尾部,同时放入hash队列中.
+// 将缓冲块放入hash队列中.
+// 此时缓冲块已被占用(b_count=1),它要等到brelse()释放时才会重新进入LRU链表.
 static inline void insert_into_queues(struct buffer_head * bh)
 {
-	/* put at end of free list */
-	/* 放在空闲链表末尾处 */
-	bh->b_next_free = free_list;
-	bh->b_prev_free = free_list->b_prev_free;
-	free_list->b_prev_free->b_next_free = bh;
-	free_list->b_prev_free = bh;
 	/* put the buffer in new hash-queue if it has a device */
 	/* 如果该缓冲块对应一个设备,则将其插入新hash队列中 */
 	bh->b_prev = NULL;
@@ -240,10 +478,13 @@ static struct buffer_head * find_buffer(int dev, int block)
 {
 	struct buffer_head * tmp;
 
-	// 搜索hash表,寻找指定设备与和块号的缓冲块.
-	for (tmp = hash(dev, block) ; tmp != NULL ; tmp = tmp->b_next)
+	// 搜索hash表,寻找指定设备与和块号的缓冲块.同时统计查找次数和比较过的缓冲块数,两者之比即平均查找长度.
+	buffer_stat.bs_hash_lookups++;
+	for (tmp = hash(dev, block) ; tmp != NULL ; tmp = tmp->b_next) {
+		buffer_stat.bs_hash_probes++;
 		if (tmp->b_dev == dev && tmp->b_blocknr == block)
 			return tmp;
+	}
 	return NULL;
 }
 
@@ -263,17 +504,69 @@ struct buffer_head * get_hash_table(int dev, int block)
 {
 	struct buffer_head * bh;
 
+	// 虚拟盘块有固定的缓冲头,总是"在高速缓冲中".
+	if (bh = rd_getblk(dev, block))
+		return bh;
 	for (;;) {
 		// 在高速缓冲中寻找给定设备和指定块的缓冲区块,如果没有找到则返回NULL,退出.
 		if (!(bh = find_buffer(dev, block)))
 			return NULL;
 		// 对该缓冲块增加引用计数,并等待该缓冲块解锁(如果已被上锁).由于经过了睡眠状态,因此有必要再验证该缓冲块的正确性,并返回缓冲块头指针.
+		// 原来空闲的缓冲块被占用后要离开LRU链表.
+		if (!bh->b_count)
+			remove_from_lru(bh);
 		bh->b_count++;
 		wait_on_buffer(bh);
 		if (bh->b_dev == dev && bh->b_blocknr == block)
 			return bh;
 		// 如果在睡眠时该缓冲块所属的设备号或块号发生的改变,则撤消对它的用计数.重新寻找.
-		bh->b_count--;
+		if (!--bh->b_count)
+			insert_into_lru(bh);
+	}
+}
+
+// 从LRU链表中挑选一个可以重用(b_count=0)的缓冲块.
+// 链表中记录的状态只是缓冲块释放时的状态,因此取出时还要再检查一次,状态已经改变的块会被移到正确的链表中.每个缓冲块移动
+// 后就不再位于原链表头部,所以挑选操作的平均代价是O(1),与缓冲块总数NR_BUFFERS无关.
+// 优先选择干净链表LRU端的块.干净链表为空时,先把锁定链表中I/O已经完成的块重新归类(只扫描一遍);仍然没有干净块的话,
+// 才退而选择已修改链表LRU端的块,最后是正在进行I/O的块(调用者会等待它).若所有缓冲块都在使用中则返回NULL.
+static struct buffer_head * get_free_buffer(void)
+{
+	struct buffer_head * bh;
+	int n, scanned = 0;
+
+	for (;;) {
+		if (bh = lru_list[BUF_CLEAN]) {
+			if (bh->b_list == BUF_LIST(bh)) {
+				buffer_stat.bs_clean_victims++;
+				return bh;
+			}
+			refile_buffer(bh);
+			continue;
+		}
+		if (!scanned) {
+			scanned = 1;
+			for (n = buffer_stat.bs_nr_free[BUF_LOCKED] ; n > 0 ; n--) {
+				bh = lru_list[BUF_LOCKED];
+				if (bh->b_lock)
+					lru_list[BUF_LOCKED] = bh->b_next_free;		// 仍被锁定,转到链表尾部.
+				else
+					refile_buffer(bh);
+			}
+			if (lru_list[BUF_CLEAN])
+				continue;
+		}
+		if (bh = lru_list[BUF_DIRTY]) {
+			if (bh->b_list != BUF_LIST(bh)) {
+				refile_buffer(bh);
+				continue;
+			}
+			buffer_stat.bs_dirty_victims++;
+			return bh;
+		}
+		if (bh = lru_list[BUF_LOCKED])
+			buffer_stat.bs_locked_victims++;
+		return bh;
 	}
 }
 
@@ -290,41 +583,22 @@ struct buffer_head * get_hash_table(int dev, int block)
  *
  * 算法已经作了改变:希望能更好,而且一个难以琢磨的错误已经去除.
  */
-// 下面宏用于同时判断缓冲区的修改标志和锁定标志,并且定义修改标志的权重要比锁定标志大.
-#define BADNESS(bh) (((bh)->b_dirt << 1) + (bh)->b_lock)
 // 取高速缓冲中指定的缓冲块.
 // 检查指定(设备号和块号)的缓冲区是否已经在高速缓冲中.如果指定块已经在高速缓冲中,则返回对应缓冲区头指针退出;如果不在,就需要在高速中
 // 中设置一个对应设备号和块号的新项.返回相应缓冲区头指针.
 struct buffer_head * getblk(int dev, int block)
 {
-	struct buffer_head * tmp, * bh;
+	struct buffer_head * bh;
 
 repeat:
-	if (bh = get_hash_table(dev, block))
+	buffer_stat.bs_lookups++;
+	if (bh = get_hash_table(dev, block)) {
+		buffer_stat.bs_hits++;
 		return bh;
-	// 扫描空闲数据块链表,寻找空闲缓冲区.
-	// 首先让tmp指向空闲链表的第一个空闲缓冲区头.
-	tmp = free_list;
-	do {
-		// 如果该缓冲区正在被使用(引用计数不等于0),则继续扫描下一项.对于b_count=0的块,即高速缓冲中当前没有引用的块不一定就是干净的(b_dirt=0)
-		// 或没有锁定的(b_lock=0).因此,我们还是需要继续下面的判断和选择.例如当一个任务改写过一块内容后就释放了,于是该块b_count=0,但b_lock不等于0;
-		// 当一个任务执行breada()预读几个块时,只要ll_rw_block()命令发出后,它就会递减b_count;但此时实际上硬盘访问操作可能还在进行,因此此时
-		// b_lock=1,但b_count=0.
-		if (tmp->b_count)
-			continue;
-		// 如果缓冲头指针bh为空,或者tmp所指缓冲头的标志(修改,锁定)权重小于bh头标志的权重,则让bh指向tmp缓冲块头.如果该tmp缓冲块头表明缓冲
-		// 块既没有修改也没有锁定标志置位,则说明已为指定设备上的块取得对应的高速缓冲块,则退出循环.否则我们就继续执行本循环,看看能否找到一个BADNESS()
-		// 最小的缓冲块.
-		if (!bh || BADNESS(tmp) < BADNESS(bh)) {
-			bh = tmp;
-			if (!BADNESS(tmp))
-				break;
-		}
-	/* and repeat until we find something good */	/* 重复操作直到找到适合的缓冲块 */
-	} while ((tmp = tmp->b_next_free) != free_list);
-	// 如果循环检查发现所有缓冲块都正在被使用(所有缓冲块的状况引用计数者>0)中,则睡眠等待有空闲缓冲区可用.当有空闲缓冲块可用时本各会被明确地唤醒.然后
-	// 我们就跳转到函数开始处重新查找空闲缓冲块.
-	if (!bh) {
+	}
+	// 从空闲LRU链表中取一个可重用的缓冲块.如果所有缓冲块都正在被使用(引用计数>0),则睡眠等待有空闲缓冲区可用.当有空闲缓冲块可用时
+	// 本进程会被明确地唤醒.然后我们就跳转到函数开始处重新查找空闲缓冲块.
+	if (!(bh = get_free_buffer())) {
 		sleep_on(&buffer_wait);
 		goto repeat;
 	}
@@ -333,9 +607,15 @@ repeat:
 	wait_on_buffer(bh);
 	if (bh->b_count)	// 又被占用??
 		goto repeat;
-	// 如果该缓冲区已被修改,则将数据写盘,并再次等待缓冲区解锁.同样地,若该缓冲区又被其他任务使用的话,只好再重复上述寻找过程.
+	// 如果该缓冲区已被修改,则唤醒回写任务,自己睡眠等待它写出一批缓冲块后再重新寻找干净的缓冲块.这样缺页的进程不用再为整个设备的
+	// 同步操作付出代价.若回写任务尚未运行(系统初始化期间),或者当前进程就是回写任务,则只把这一块写盘并等待其完成.
 	while (bh->b_dirt) {
-		sync_dev(bh->b_dev);
+		if (bdflush_task && current != bdflush_task) {
+			wake_up(&bdflush_wait);
+			sleep_on(&buffer_wait);
+			goto repeat;
+		}
+		ll_rw_block(WRITE, bh);
 		wait_on_buffer(bh);
 		if (bh->b_count)	// 又被占用??
 			goto repeat;
@@ -354,9 +634,10 @@ repeat:
 	bh->b_count = 1;
 	bh->b_dirt = 0;
 	bh->b_uptodate = 0;
-	// 从hash队列和空闲块链表中移出该缓冲头,让该缓冲区用于指定设备和其上的指定块.然后根据此新设备号和块号重新插入空闲链表和hash队列新位置处.并最终返回缓冲
-	// 头指针.
+	// 从hash队列和空闲LRU链表中移出该缓冲头,让该缓冲区用于指定设备和其上的指定块.然后根据此新设备号和块号重新插入hash队列新位置处.它要等到
+	// 被释放时才会重新进入LRU链表.并最终返回缓冲头指针.
 	remove_from_queues(bh);
+	remove_from_inode_list(bh);
 	bh->b_dev = dev;
 	bh->b_blocknr = block;
 	insert_into_queues(bh);
@@ -364,7 +645,7 @@ repeat:
 }
 
 // 释放指定缓冲块.
-// 等待该缓冲块解锁.然后引用计数递减1,并明确地唤醒等待空闲缓冲块的进程.
+// 等待该缓冲块解锁.然后引用计数递减1,若已无人使用则放回LRU链表,并明确地唤醒等待空闲缓冲块的进程.
 void brelse(struct buffer_head * buf)
 {
 	if (!buf)						// 如果缓冲头指针无效则返回.
@@ -372,6 +653,17 @@ void brelse(struct buffer_head * buf)
 	wait_on_buffer(buf);
 	if (!(buf->b_count--))
 		panic("Trying to free free buffer");
+	// 虚拟盘块的数据就在虚拟盘中,修改后无需写盘,也不进入LRU链表.
+	if (buf->b_list == BUF_RAMDISK) {
+		buf->b_dirt = 0;
+		return;
+	}
+	// 最后一个使用者释放后,缓冲块按其状态进入相应LRU链表的MRU端.
+	if (!buf->b_count) {
+		insert_into_lru(buf);
+		if (buf->b_list == BUF_DIRTY && TOO_MANY_DIRTY())
+			wake_up(&bdflush_wait);
+	}
 	wake_up(&buffer_wait);
 }
 
@@ -465,6 +757,26 @@ void bread_page(unsigned long address, int dev, int b[4])
 		}
 }
 
+// 预读设备dev上的数据块block.
+// 若该块不在高速缓冲中(或数据无效),则发出预读请求READA,但并不等待读操作完成.由于数据只是稍后才会用到,这里不能调用brelse()(它会
+// 等待缓冲块解锁),而是直接递减引用计数,让该块(此时通常被锁定)进入LRU链表.虚拟盘块的数据总是在内存中,它也不能进入LRU链表,
+// 所以直接用brelse()释放.
+void bread_ahead(int dev, int block)
+{
+	struct buffer_head * bh;
+
+	if (!(bh = getblk(dev, block)))
+		return;
+	if (bh->b_list == BUF_RAMDISK) {
+		brelse(bh);
+		return;
+	}
+	if (!bh->b_uptodate)
+		ll_rw_block(READA, bh);
+	if (!--bh->b_count)
+		insert_into_lru(bh);
+}
+
 /*
  * Ok, breada can be used as bread, but additionally to mark other
  * blocks for reading as well. End the argument list with a negative
@@ -478,7 +790,7 @@ void bread_page(unsigned long address, int dev, int b[4])
 struct buffer_head * breada(int dev, int first, ...)
 {
 	va_list args;
-	struct buffer_head * bh, *tmp;
+	struct buffer_head * bh;
 
 	// 首先取可变参数表中第1个参数(块号).接着从调整缓冲区中取指定设备和块号的缓冲块.如果该缓冲块数据无效(更新标志未置位),则
 	// 发出读设备数据块请求.
@@ -487,17 +799,10 @@ struct buffer_head * breada(int dev, int first, ...)
 		panic("bread: getblk returned NULL\n");
 	if (!bh->b_uptodate)
 		ll_rw_block(READ, bh);
-	// 然后顺序取可变参数表中其他预读块号,并作与上面同样处理,但不引用.注意,336行上有一个bug.其中的bh应该是tmp.这个bug直到在0.96
-	// 版的内核代码中才被纠正过来.另外,因为这里是预读随后的数据块,只需读进调整缓冲区但并不马上就使用,所以第337行语句需要将其引用计数
-	// 递减释放掉该块(因为getblk()函数会增加缓冲块引用计数值).
-	while ((first = va_arg(args, int)) >= 0) {
-		tmp = getblk(dev, first);
-		if (tmp) {
-			if (!tmp->b_uptodate)
-				ll_rw_block(READA, tmp);
-			tmp->b_count--;					// 暂时释放掉该预读块.
-		}
-	}
+	// 然后顺序取可变参数表中其他预读块号,并作与上面同样处理,但不引用.因为这里是预读随后的数据块,只需读进调整缓冲区但并不马上就使用,
+	// 所以bread_ahead()会递减其引用计数释放掉该块(因为getblk()函数会增加缓冲块引用计数值).
+	while ((first = va_arg(args, int)) >= 0)
+		bread_ahead(dev, first);
 	// 此时可变参数表中所有参数处理完毕.于是等待第1个缓冲区解锁(如果已被上锁).在等待退出之后如果缓冲区中数据仍然有效,则返回缓冲区头指针
 	// 退出.否则释放该缓冲区返回NULL,退出.
 	va_end(args);
@@ -508,14 +813,100 @@ struct buffer_head * breada(int dev, int first, ...)
 	return (NULL);
 }
 
+// 回写一批已修改的缓冲块.
+// 从已修改链表的LRU端开始,写出已经到期(b_flushtime <= jiffies)的缓冲块,每次最多写bdf_prm.b_un.ndirty块.当已修改块
+// 过多或者干净链表已空时,不论是否到期都写出.写盘请求发出后,缓冲块被锁定且不再是"脏"的,立即把它移到锁定链表中.最后等待
+// 最后一个写请求完成,使得在buffer_wait上等待的进程醒来时能找到干净的缓冲块.返回写出的块数.
+static int flush_dirty_buffers(void)
+{
+	struct buffer_head * bh, * last = NULL;
+	int n, nwritten = 0, force;
+
+	force = TOO_MANY_DIRTY() || !lru_list[BUF_CLEAN];
+	for (n = buffer_stat.bs_nr_free[BUF_DIRTY] ; n > 0 ; n--) {
+		if (!(bh = lru_list[BUF_DIRTY]) || nwritten >= bdf_prm.b_un.ndirty)
+			break;
+		if (bh->b_list != BUF_LIST(bh)) {
+			refile_buffer(bh);
+			continue;
+		}
+		if (!force && bh->b_flushtime > jiffies) {
+			lru_list[BUF_DIRTY] = bh->b_next_free;		// 尚未到期,转到链表尾部.
+			continue;
+		}
+		ll_rw_block(WRITE, bh);
+		// ll_rw_block()可能会睡眠,此时该块可能已被其他进程占用而离开LRU链表.
+		if (!bh->b_count)
+			refile_buffer(bh);
+		last = bh;
+		nwritten++;
+	}
+	buffer_stat.bs_flushed += nwritten;
+	if (last)
+		wait_on_buffer(last);
+	return nwritten;
+}
+
+// 缓冲回写任务系统调用.
+// func = 0时,调用进程成为回写任务并且不再返回:它每隔bdf_prm.b_un.interval个滴答,或者被getblk()/brelse()唤醒时,写出一批
+// 已修改的缓冲块.系统中只能有一个回写任务(由init进程在系统启动时创建).
+// func = 1时,立即唤醒回写任务.
+// func >= 2时,用于读写参数:参数序号i = (func - 2) / 2,func为偶数时把参数值写到用户空间data处,为奇数时把参数设置为data.
+// 除读取参数外,其他操作都需要超级用户权限.
+int sys_bdflush(int func, long data)
+{
+	int i;
+
+	if (func >= 2) {
+		i = (func - 2) >> 1;
+		if (i >= N_PARAM)
+			return -EINVAL;
+		if (!(func & 1)) {
+			verify_area((void *) data, sizeof(long));
+			put_fs_long(bdf_prm.data[i], (unsigned long *) data);
+			return 0;
+		}
+		if (!suser())
+			return -EPERM;
+		if (data < bdflush_min[i] || data > bdflush_max[i])
+			return -EINVAL;
+		bdf_prm.data[i] = data;
+		wake_up(&bdflush_wait);
+		return 0;
+	}
+	if (!suser())
+		return -EPERM;
+	if (func == 1) {
+		wake_up(&bdflush_wait);
+		return 0;
+	}
+	if (func)
+		return -EINVAL;
+	if (bdflush_task)
+		return -EBUSY;
+	bdflush_task = current;
+	// 回写任务从不返回用户态,因此不会处理信号.这里丢弃收到的信号,以免它们使下面的可中断睡眠立即返回.
+	for (;;) {
+		current->signal = 0;
+		i = flush_dirty_buffers();
+		wake_up(&buffer_wait);
+		if (i && TOO_MANY_DIRTY())
+			continue;
+		current->timeout = jiffies + bdf_prm.b_un.interval;
+		interruptible_sleep_on(&bdflush_wait);
+		current->timeout = 0;
+	}
+}
+
 // 缓冲区初始化函数
 // 参数buffer_end是缓冲区内存末端.对于具有16M内存的系统,缓冲区末端被设置为4MB.对于有8MB内存的系统,缓冲区末端被设置2MB.该函数从缓冲区开始位置
 // start_buffer处和缓冲区末端buffer_end处分别同时设置(初始化)缓冲块头结构和对应的数据块.直到缓冲区中所有内存被分配完毕.
 void buffer_init(long buffer_end)
 {
-	struct buffer_head * h = start_buffer;
+	struct buffer_head * h;
 	void * b;
 	int i;
+	long nr;
 
 	// 首先根据参数提供的缓冲区高端位置确定实际缓冲区高端位置b.如果缓冲区高端等于1MB,则因为从640KB-1MB被显示内存和BIOS占用,所以实际可用缓冲区内存
 	// 高端位置应该是640KB.否则缓冲区内存高端一定大于1MB.
@@ -523,6 +914,19 @@ void buffer_init(long buffer_end)
 		b = (void *) (640 * 1024);
 	else
 		b = (void *) buffer_end;
+	// hash表放在缓冲区最低端(内核代码末端end处),缓冲头结构紧随其后.表的大小取不小于缓冲块数估计值的2的幂,使平均每个hash链长度
+	// 不超过1.缓冲块数按每块占用一个缓冲头和1KB数据来估计(若跨越了640KB-1MB区域,要扣除这384KB).
+	nr = (long) b - (long) &end;
+	if ((long) b > 0x100000)
+		nr -= 0x100000 - 0xA0000;
+	nr /= BLOCK_SIZE + sizeof(struct buffer_head);
+	for (hash_bits = 4 ; (1L << hash_bits) < nr ; hash_bits++)
+		/* nothing */ ;
+	NR_HASH = 1 << hash_bits;
+	hash_table = (struct buffer_head **) &end;
+	for (i = 0; i < NR_HASH; i++)
+		hash_table[i] = NULL;
+	start_buffer = h = (struct buffer_head *) (hash_table + NR_HASH);
 	// 这段代码用于初始化缓冲区,建立空闲缓冲块循环链表,并获取系统中缓冲块数目.操作的过程是从缓冲区高端开始划分1KB大小的缓冲块,与此同时在缓冲区低端建立
 	// 描述该缓冲块的结构buffer_head,并将这些buffer_head组成双向链表.
 	// h是指向缓冲头结构的指针,而h+1是指向内存地址连续的下一个缓冲头地址,也可以说是指向h缓冲有头的末端外.为了保证有足够长度的内存来存储一个缓冲头结构,
@@ -534,21 +938,21 @@ void buffer_init(long buffer_end)
 		h->b_lock = 0;								// 缓冲块锁定标志.
 		h->b_uptodate = 0;							// 缓冲块更新标志(或称数据有效标志).
 		h->b_wait = NULL;							// 指向等待该缓冲块解锁的进程.
+		h->b_flushtime = 0;							// 回写时刻.
 		h->b_next = NULL;							// 指向具有相同hash值的下一个缓冲头.
 		h->b_prev = NULL;							// 指向具有相同hash值的前一个缓冲头.
 		h->b_data = (char *) b;						// 指向对应缓冲块数据块(1024字节).
-		h->b_prev_free = h - 1;						// 指向链表中前一项.
-		h->b_next_free = h + 1;						// 指向链表中下一项.
+		h->b_prev_free = NULL;						// 指向链表中前一项.
+		h->b_next_free = NULL;						// 指向链表中下一项.
+		h->b_reqnext = NULL;						// 指向同一请求项中的下一缓冲块.
+		h->b_inode = NULL;							// 所属文件的i节点.
+		h->b_inode_next = NULL;
+		h->b_inode_prev = NULL;
+		insert_into_lru(h);							// 放入干净链表尾部.
 		h++;										// h指向下一新缓冲头位置.
 		NR_BUFFERS++;								// 缓冲区块数累加.
 		if (b == (void *) 0x100000)					// 若b递减到等于1MB,则跳过384KB
 			b = (void *) 0xA0000;					// 让b指向地址0xA0000(640KB)处.
 	}
-	h--;											// 让h指向最后一个有效缓冲块头.
-	free_list = start_buffer;						// 让空闲链表头指向头一个缓冲块.
-	free_list->b_prev_free = h;     				// 链表头的b_prev_free指向前一项（即最后一项）。
-	h->b_next_free = free_list;     				// h的下一项指针指向第一项，形成一个环链。
-	// 最后初始化hash表(哈希表、散列表),置表中所有指针为NULL。
-	for (i = 0; i < NR_HASH; i++)
-		hash_table[i] = NULL;
+	buffer_stat.bs_nr_buffers = NR_BUFFERS;
 }
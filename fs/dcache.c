@@ -0,0 +1,255 @@
+/*
+ *  linux/fs/dcache.c
+ */
+
+/*
+ * Directory entry cache. find_entry() has to scan a directory block by
+ * block, so resolving "/usr/bin/x" re-reads the same directories on
+ * every exec and open. Here we remember where a name was found: the
+ * block and the offset of the entry. Names that weren't found are
+ * remembered too (block 0), so a failing lookup along PATH doesn't
+ * scan the directory again either.
+ *
+ * A positive entry is only a hint - find_entry() re-checks the name in
+ * the directory block before trusting it. Negative entries have to be
+ * removed whenever a name is added to a directory.
+ */
+/*
+ * 目录项高速缓存.find_entry()需要一块一块地扫描目录,因此每次exec和open解析"/usr/bin/x"时都要重新读取同样的目录.这里记住名字
+ * 在目录中的位置:目录项所在的盘块号和块内偏移.没有找到的名字也会被记住(块号为0),这样沿PATH查找失败时也不必再扫描一遍目录.
+ *
+ * 找到的缓存项只是一个提示 -- find_entry()在使用前会在目录块中重新比较名字.而"不存在"的缓存项则必须在目录中加入名字时删除.
+ */
+#include <errno.h>
+
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <asm/segment.h>
+
+#define NR_DCACHE	128									// 缓存项数.
+#define DC_HASH		64									// hash表项数.
+
+struct dir_cache_entry {
+	unsigned short dc_dev;								// 目录所在设备号.
+	unsigned short dc_dir;								// 目录i节点号.
+	unsigned short dc_block;							// 目录项所在盘块号,0表示名字不存在.
+	unsigned short dc_offset;							// 目录项在块内的偏移.
+	unsigned char dc_len;								// 名字长度.
+	char dc_name[NAME_LEN];								// 名字.
+	struct dir_cache_entry * dc_next;					// hash链.
+	struct dir_cache_entry * dc_prev;
+	struct dir_cache_entry * dc_next_lru;				// LRU链表,表头是最近最少使用的项.
+	struct dir_cache_entry * dc_prev_lru;
+};
+
+static struct dir_cache_entry dcache[NR_DCACHE];
+static struct dir_cache_entry * dc_hash[DC_HASH];
+static struct dir_cache_entry * dc_lru = NULL;
+static struct dcache_stat dcache_stat = { 0, };		// 统计信息.
+
+/*
+ * find_entry() may sleep while it scans a directory, and somebody may
+ * add the name meanwhile. dcache_seq changes whenever entries are
+ * dropped, so a negative entry is only added if nothing changed.
+ */
+/*
+ * find_entry()在扫描目录时可能睡眠,其间别的进程可能在目录中加入了该名字.每次删除缓存项时dcache_seq都会改变,因此只有在其
+ * 没有变化时才加入"不存在"的缓存项.
+ */
+unsigned long dcache_seq = 0;
+
+static int hashname(const char * name, int len)
+{
+	int h = 0;
+
+	while (len--)
+		h = (h << 1) ^ *name++;
+	return h;
+}
+
+#define hashfn(dev, dir, h) ((unsigned) ((dev) ^ (dir) ^ (h)) % DC_HASH)
+#define hash(dc) dc_hash[hashfn((dc)->dc_dev, (dc)->dc_dir, hashname((dc)->dc_name, (dc)->dc_len))]
+
+// 名字在用户空间中,先复制到内核中再计算hash值.
+static int dc_getname(const char * name, int len, char * buf)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = get_fs_byte(name + i);
+	return hashname(buf, len);
+}
+
+static void remove_from_hash(struct dir_cache_entry * dc)
+{
+	if (dc->dc_next)
+		dc->dc_next->dc_prev = dc->dc_prev;
+	if (dc->dc_prev)
+		dc->dc_prev->dc_next = dc->dc_next;
+	if (hash(dc) == dc)
+		hash(dc) = dc->dc_next;
+	dc->dc_next = dc->dc_prev = NULL;
+	dc->dc_dev = 0;
+}
+
+// 把缓存项移到LRU链表尾(最近使用).
+static void touch(struct dir_cache_entry * dc)
+{
+	if (dc == dc_lru) {
+		dc_lru = dc->dc_next_lru;
+		return;
+	}
+	dc->dc_prev_lru->dc_next_lru = dc->dc_next_lru;
+	dc->dc_next_lru->dc_prev_lru = dc->dc_prev_lru;
+	dc->dc_next_lru = dc_lru;
+	dc->dc_prev_lru = dc_lru->dc_prev_lru;
+	dc_lru->dc_prev_lru->dc_next_lru = dc;
+	dc_lru->dc_prev_lru = dc;
+}
+
+// 把缓存项移到LRU链表头,下次最先被重用.
+static void untouch(struct dir_cache_entry * dc)
+{
+	touch(dc);
+	dc_lru = dc;
+}
+
+static struct dir_cache_entry * find(int dev, int dir, const char * name, int len, int h)
+{
+	struct dir_cache_entry * dc;
+	int i;
+
+	for (dc = dc_hash[hashfn(dev, dir, h)]; dc; dc = dc->dc_next) {
+		if (dc->dc_dev != dev || dc->dc_dir != dir || dc->dc_len != len)
+			continue;
+		for (i = 0; i < len; i++)
+			if (dc->dc_name[i] != name[i])
+				break;
+		if (i == len)
+			return dc;
+	}
+	return NULL;
+}
+
+static void dcache_init(void)
+{
+	int i;
+
+	for (i = 0; i < NR_DCACHE; i++) {
+		dcache[i].dc_next_lru = dcache + (i + 1) % NR_DCACHE;
+		dcache[i].dc_prev_lru = dcache + (i + NR_DCACHE - 1) % NR_DCACHE;
+	}
+	dc_lru = dcache;
+}
+
+/*
+ * Look up name in directory dir. Returns 1 and the block/offset of the
+ * entry if it is cached (block 0 means the name doesn't exist), and 0
+ * if we don't know.
+ */
+/*
+ * 在目录dir中查找名字.若在缓存中,返回1以及目录项的盘块号和块内偏移(块号为0表示该名字不存在);不在缓存中则返回0.
+ */
+int dcache_lookup(struct m_inode * dir, const char * name, int len,
+	int * block, int * offset)
+{
+	struct dir_cache_entry * dc;
+	char buf[NAME_LEN];
+	int h;
+
+	h = dc_getname(name, len, buf);
+	if (!(dc = find(dir->i_dev, dir->i_num, buf, len, h))) {
+		dcache_stat.ds_misses++;
+		return 0;
+	}
+	touch(dc);
+	if (dc->dc_block)
+		dcache_stat.ds_hits++;
+	else
+		dcache_stat.ds_neg_hits++;
+	*block = dc->dc_block;
+	*offset = dc->dc_offset;
+	return 1;
+}
+
+// 记住名字在目录中的位置.block为0表示目录中没有该名字.
+void dcache_add(struct m_inode * dir, const char * name, int len,
+	int block, int offset)
+{
+	struct dir_cache_entry * dc;
+	char buf[NAME_LEN];
+	int h, i;
+
+	if (!dc_lru)
+		dcache_init();
+	h = dc_getname(name, len, buf);
+	if (!(dc = find(dir->i_dev, dir->i_num, buf, len, h))) {
+		dc = dc_lru;
+		if (dc->dc_dev)
+			remove_from_hash(dc);
+		dc->dc_dev = dir->i_dev;
+		dc->dc_dir = dir->i_num;
+		dc->dc_len = len;
+		for (i = 0; i < len; i++)
+			dc->dc_name[i] = buf[i];
+		i = hashfn(dir->i_dev, dir->i_num, h);
+		if ((dc->dc_next = dc_hash[i]))
+			dc->dc_next->dc_prev = dc;
+		dc_hash[i] = dc;
+	}
+	dc->dc_block = block;
+	dc->dc_offset = offset;
+	touch(dc);
+}
+
+// 删除目录dir中名字的缓存项.在目录中加入或删除名字时调用.
+void dcache_remove(struct m_inode * dir, const char * name, int len)
+{
+	struct dir_cache_entry * dc;
+	char buf[NAME_LEN];
+	int h;
+
+	dcache_seq++;
+	h = dc_getname(name, len, buf);
+	if ((dc = find(dir->i_dev, dir->i_num, buf, len, h))) {
+		remove_from_hash(dc);
+		untouch(dc);
+	}
+}
+
+// 删除目录dir的所有缓存项.目录被删除后其i节点号可能被新目录重用,所以必须清除.
+void dcache_invalidate_dir(struct m_inode * dir)
+{
+	struct dir_cache_entry * dc;
+
+	dcache_seq++;
+	for (dc = dcache; dc < dcache + NR_DCACHE; dc++)
+		if (dc->dc_dev == dir->i_dev && dc->dc_dir == dir->i_num) {
+			remove_from_hash(dc);
+			untouch(dc);
+		}
+}
+
+// 删除设备dev的所有缓存项.在安装,卸载文件系统和更换软盘时调用.
+void dcache_invalidate_dev(int dev)
+{
+	struct dir_cache_entry * dc;
+
+	dcache_seq++;
+	for (dc = dcache; dc < dcache + NR_DCACHE; dc++)
+		if (dc->dc_dev == dev) {
+			remove_from_hash(dc);
+			untouch(dc);
+		}
+}
+
+// 取目录项缓存统计信息.
+// 把统计结构dcache_stat复制到用户空间stat处.成功返回0.
+int sys_dcachestat(struct dcache_stat * stat)
+{
+	if (!stat)
+		return -EINVAL;
+	verify_area(stat, sizeof *stat);
+	memcpy_tofs(stat, &dcache_stat, sizeof *stat);
+	return 0;
+}
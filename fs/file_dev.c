@@ -14,6 +14,52 @@
 #define MIN(a, b) (((a) < (b)) ? (a) : (b))    					// 取a、b中的最小值
 #define MAX(a, b) (((a) > (b)) ? (a) : (b))    					// 取a、b中的最大值
 
+// 预读窗口的最小值和最大值（块数）。
+#define READA_MIN	4
+#define READA_MAX	32
+
+// 文件顺序预读。
+// 每个打开的文件（file结构）记录上次读操作结束的位置f_ra_pos。若本次读操作从该位置开始，则认为是顺序读，预读窗口f_ra_window
+// 从READA_MIN开始每次加倍，直到READA_MAX；否则认为是随机读，窗口缩为0。除本次读操作要用到的块外，还预读其后窗口大小的若干块。
+// 为避免每次读操作都去查找高速缓冲，只有当已预读的块（f_ra_end）所剩不足半个窗口时才再发出一批预读请求。预读请求都是READA，
+// 不等待读操作完成，请求队列满时会被丢弃。
+static void file_readahead(struct m_inode * inode, struct file * filp, int count)
+{
+	unsigned long block, last, end, size;
+	int nr;
+
+	block = filp->f_pos / BLOCK_SIZE;
+	last = (filp->f_pos + count - 1) / BLOCK_SIZE;
+	if (filp->f_pos == filp->f_ra_pos) {
+		if (!filp->f_ra_window)
+			filp->f_ra_window = READA_MIN;
+		else if (filp->f_ra_window < READA_MAX)
+			filp->f_ra_window <<= 1;
+	} else {
+		filp->f_ra_window = 0;
+		filp->f_ra_end = block;
+	}
+	// 确定本次预读的范围[block, end)，不超出文件末尾。
+	if (filp->f_ra_end > block)
+		block = filp->f_ra_end;
+	end = last + 1;
+	if (filp->f_ra_window) {
+		if (block > last + filp->f_ra_window / 2)
+			return;
+		end += filp->f_ra_window;
+	}
+	size = (inode->i_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	if (end > size)
+		end = size;
+	// 对于单块的随机读，直接由下面的bread()读取即可。
+	if (end <= block + 1 && !filp->f_ra_window)
+		return;
+	for ( ; block < end ; block++)
+		if (nr = bmap(inode, block))
+			bread_ahead(inode->i_dev, nr);
+	filp->f_ra_end = block;
+}
+
 // 文件读函数 - 根据i节点和文件结构，读取文件中数据。
 // 由i节点我们可以知道设备号，由filp结构可以知道文件中当前读写指针位置。buf指定用户空间中缓冲区的位置，count是需要读取的字节数。
 // 返回值是实际读取的字节数，或出错号（小于0）。
@@ -28,6 +74,7 @@ int file_read(struct m_inode * inode, struct file * filp, char * buf, int count)
 	// 块指针为NULL。
 	if ((left = count) <= 0)
 		return 0;
+	file_readahead(inode, filp, count);
 	while (left) {
 		// 根据文件的读写偏移位置得到当前写位置对应的逻辑块号
 		if (nr = bmap(inode, (filp->f_pos) / BLOCK_SIZE)) {
@@ -46,9 +93,8 @@ int file_read(struct m_inode * inode, struct file * filp, char * buf, int count)
 		// 若上面从设备上读到了数据，则将p指向缓冲块中开始读取数据的位置，并且复制chars字节到用户缓冲区buf中。否则往用户缓冲区中填入chars
 		// 个值字节。
 		if (bh) {
-			char * p = nr + bh->b_data;
-			while (chars-- > 0)
-				put_fs_byte(*(p++), buf++);
+			memcpy_tofs(buf, nr + bh->b_data, chars);
+			buf += chars;
 			brelse(bh);
 		} else {
 			while (chars-- > 0)
@@ -57,6 +103,7 @@ int file_read(struct m_inode * inode, struct file * filp, char * buf, int count)
 	}
 	// 修改该i节点的访问时间为当前时间。返回读取的字节数，若读取字节数为0,则返回出错号。
 	// CURRENT_TIME是定义在include/linux/sched.h上的宏，用于计算UNIX时间。即从1970年1月1日0时0秒开始，到当前时间。单位是秒。
+	filp->f_ra_pos = filp->f_pos;
 	inode->i_atime = CURRENT_TIME;
 	return (count - left) ? (count-left) : -ERROR;
 }
@@ -86,31 +133,37 @@ int file_write(struct m_inode * inode, struct file * filp, char * buf, int count
 		pos = filp->f_pos;
 	// 然后在已写入字节数i（刚开始时为0）小于指定写入字节数count时，循环执行以下操作。在循环操作过程中，我们先取文件数据块
 	// 号（pos/BLOCK_SIZE）在设备上对应的逻辑块号block。如果对应的逻辑块不存在就创建一块。如果得到的逻辑块号 = 0,则表示
-	// 创建失败，于是退出循环。否则我们根据该逻辑块号读取设备上的相应逻辑块，若出错也退出循环。
+	// 创建失败，于是退出循环。否则我们根据该逻辑块号读取设备上的相应逻辑块，若出错也退出循环。如果这次要写满整个数据块，块中原有
+	// 内容会被全部覆盖，就不必先从设备上读入，直接取得一个缓冲块即可。
 	while (i < count) {
 		if (!(block = create_block(inode, pos / BLOCK_SIZE)))
 			break;
-		if (!(bh = bread(inode->i_dev, block)))
-			break;
-		// 此时缓冲块指针bh正指向刚读入的文件数据块。现在再求出文件当前读写指针在该数据块中的偏移值c，并将指针p指向缓冲块中开始写入
-		// 数据的位置，并置该缓冲块已修改标志。对于块中当前指针，从开始读写位置到块末共可写入c = (BLOCK_SIZE - c)个字节。若c大
-		// 于剩余还需写入的字节数（count - i），则此次只需再定稿c = (count-i)个字节即可。
 		c = pos % BLOCK_SIZE;
+		if (!c && count - i >= BLOCK_SIZE)
+			bh = getblk(inode->i_dev, block);
+		else
+			bh = bread(inode->i_dev, block);
+		if (!bh)
+			break;
+		// 此时缓冲块指针bh正指向文件数据块。现在将指针p指向缓冲块中开始写入数据的位置。对于块中当前指针，从开始读写位置到块末共可写入
+		// c = (BLOCK_SIZE - c)个字节。若c大于剩余还需写入的字节数（count - i），则此次只需再定稿c = (count-i)个字节即可。
 		p = c + bh->b_data;
-		bh->b_dirt = 1;
 		c = BLOCK_SIZE - c;
 		if (c > count - i) c = count - i;
 		// 在写入数据之前，我们先预先设置好下一次循环操作要读写文件中的位置。因此我们把pos指针前移此次需要写入的字节数。如果此时pos
 		// 位置值超过了文件当前长度，则修改i节点文件长度字段，并置i节点已修改标志。然后把此次要写入的字节数c累加到已写入字节计数值i中，
-		// 供循环判断。使用接着双用户缓冲区buf中复制c个字节到调整缓冲块中p指向的开始位置处。复制完后就释放该缓冲块。
+		// 供循环判断。使用接着双用户缓冲区buf中复制c个字节到调整缓冲块中p指向的开始位置处。
 		pos += c;
 		if (pos > inode->i_size) {
 			inode->i_size = pos;
 			inode->i_dirt = 1;
 		}
 		i += c;
-		while (c-- > 0)
-			*(p++) = get_fs_byte(buf++);
+		memcpy_fromfs(p, buf, c);
+		buf += c;
+		// 复制完后缓冲块中的数据就是有效的了(整块覆盖时原来可能不是),于是置其已更新标志和已修改标志,然后释放该缓冲块。
+		bh->b_uptodate = 1;
+		mark_buffer_dirty(bh, inode);
 		brelse(bh);
     }
 	// 当数据已经全部写入文件或者在写操作过程中发生问题时就会退出循环。此时我们更改文件修改时间为当前时间，并调整文件读写指针。如果
@@ -16,7 +16,25 @@
 // 数据块总数(1块大小 = 1KB).
 extern int *blk_size[];
 
-struct m_inode inode_table[NR_INODE]={{0, }, };   					// 内存中i节点表(NR_INODE=64项)
+/*
+ * The in-core inode table is sized from the memory size at boot (see
+ * inode_init()). Inodes in use by a device are hashed on (dev, nr), and
+ * unused ones (i_count == 0) are kept on a circular LRU list, free ones
+ * at the head and just released ones at the tail, so that a cached inode
+ * is reused as late as possible.
+ */
+/*
+ * 内存i节点表的大小在启动时根据内存容量确定(见inode_init()).属于某设备的i节点按(dev, nr)放入hash表中,未使用的i节点(i_count==0)
+ * 则放在一个循环LRU链表中:空闲的在链表头,刚释放的在链表尾,使缓存着的i节点尽可能晚地被重用.
+ */
+struct m_inode * inode_table;									// 内存中i节点表,共nr_inodes项.
+int nr_inodes = 0;
+static struct m_inode ** inode_hash;							// i节点hash表,共NR_IHASH项.
+static int NR_IHASH = 0;
+static struct m_inode * free_inodes = NULL;						// 未使用i节点的LRU链表头.
+
+#define _ihashfn(dev, nr) (((unsigned) ((dev) ^ (nr))) & (NR_IHASH - 1))
+#define ihash(dev, nr) inode_hash[_ihashfn(dev, nr)]
 
 static void read_inode(struct m_inode * inode);						// 读指定i节点号的i节点信息.
 static void write_inode(struct m_inode * inode);					// 写i节点信息到高速缓冲中.
@@ -51,6 +69,68 @@ static inline void unlock_inode(struct m_inode * inode)
 	wake_up(&inode->i_wait);										// kernel/sched.c
 }
 
+// 从hash表中删除i节点.
+static void remove_from_ihash(struct m_inode * inode)
+{
+	if (inode->i_hash_next)
+		inode->i_hash_next->i_hash_prev = inode->i_hash_prev;
+	if (inode->i_hash_prev)
+		inode->i_hash_prev->i_hash_next = inode->i_hash_next;
+	else if (inode->i_dev && ihash(inode->i_dev, inode->i_num) == inode)
+		ihash(inode->i_dev, inode->i_num) = inode->i_hash_next;
+	inode->i_hash_next = inode->i_hash_prev = NULL;
+}
+
+// 把已设置好i_dev和i_num的i节点放入hash表.
+void insert_into_ihash(struct m_inode * inode)
+{
+	if ((inode->i_hash_next = ihash(inode->i_dev, inode->i_num)))
+		inode->i_hash_next->i_hash_prev = inode;
+	inode->i_hash_prev = NULL;
+	ihash(inode->i_dev, inode->i_num) = inode;
+}
+
+// 从未使用i节点链表中取下i节点.
+static void remove_from_free(struct m_inode * inode)
+{
+	if (!inode->i_next_free)
+		return;
+	if (inode->i_next_free == inode)
+		free_inodes = NULL;
+	else {
+		inode->i_prev_free->i_next_free = inode->i_next_free;
+		inode->i_next_free->i_prev_free = inode->i_prev_free;
+		if (free_inodes == inode)
+			free_inodes = inode->i_next_free;
+	}
+	inode->i_next_free = inode->i_prev_free = NULL;
+}
+
+// 把引用计数变为0的i节点放入未使用链表.cached非0时放在链表尾(以后还可能用到),否则放在链表头(下一个就重用它).
+static void put_free(struct m_inode * inode, int cached)
+{
+	if (!free_inodes) {
+		free_inodes = inode->i_next_free = inode->i_prev_free = inode;
+		return;
+	}
+	inode->i_next_free = free_inodes;
+	inode->i_prev_free = free_inodes->i_prev_free;
+	free_inodes->i_prev_free->i_next_free = inode;
+	free_inodes->i_prev_free = inode;
+	if (!cached)
+		free_inodes = inode;
+}
+
+// 清空一个不再使用的i节点(删除文件时,见free_inode()),并放到未使用链表头.
+void clear_inode(struct m_inode * inode)
+{
+	remove_from_ihash(inode);
+	remove_from_free(inode);
+	invalidate_inode_buffers(inode);
+	memset(inode, 0, sizeof(*inode));
+	put_free(inode, 0);
+}
+
 // 释放设备dev在内存i节点表中的所有i节点。
 // 扫描内存中的i节点表数组，如果是指定设备使用的i节点就释放之。
 void invalidate_inodes(int dev)
@@ -63,11 +143,13 @@ void invalidate_inodes(int dev)
 	// 着，即其引用计数是否不为0。若是则显示警告信息。然后释放之，即把i节点的设备号字段i_dev置。第50行上的指针
 	// 赋值"0+inode_table"等同于"inode_table"、"&inode_table[0]"。不过这样写可能更明了一些。
 	inode = 0 + inode_table;                  						// 指向i节点表指针数组首项。
-	for(i = 0 ; i < NR_INODE ; i++, inode++) {
+	for(i = 0 ; i < nr_inodes ; i++, inode++) {
 		wait_on_inode(inode);           							// 等待该i节点可用（解锁）。
 		if (inode->i_dev == dev) {
 			if (inode->i_count)     								// 若其引用数不为0,则显示出错警告。
 				printk("inode in use on removed disk\n\r");
+			remove_from_ihash(inode);
+			invalidate_inode_buffers(inode);
 			inode->i_dev = inode->i_dirt = 0;       				// 释放i节点（置设备号为0）。
 		}
 	}
@@ -84,32 +166,72 @@ void sync_inodes(void)
 	// 目前正被上锁的话），然后判断该i节点是否已被修改并且不是管道节点。若是这种情况则将该i节点写入高速缓冲区中，缓冲区管理
 	// 程序buffer.c会在适当时机将它们写入盘中。
 	inode = 0 + inode_table;                          				// 让指针首先指向i节点表指针数组首项。
-	for(i = 0 ; i < NR_INODE ; i++, inode++) {           			// 扫描i节点表指针数组。
+	for(i = 0 ; i < nr_inodes ; i++, inode++) {           			// 扫描i节点表指针数组。
 		wait_on_inode(inode);                   					// 等待该i节点可用（解锁）。
 		if (inode->i_dirt && !inode->i_pipe)    					// 若i节点已修改且不是管道节点，
 			write_inode(inode);             						// 则写盘（实际是写入缓冲区中）。
 	}
 }
 
+/*
+ * Every block past the first 7 costs a bread() of the indirect block in
+ * _bmap(), two past 519. Since files are mostly allocated contiguously,
+ * each inode remembers one extent: when _bmap() has an indirect block
+ * in hand anyway, it records how many of the following entries map to
+ * consecutive zones, so the next blocks of a sequential read or of
+ * demand loading don't walk the tree. Only existing blocks are cached,
+ * so allocating new blocks never makes the extent stale - only
+ * truncate() does, and it empties the cache and bumps i_ext_seq.
+ */
+/*
+ * _bmap()中第7块之后的每一块都要bread()一次间接块,519块之后要两次.由于文件大多是连续分配的,每个i节点记住一个区段:当_bmap()手中
+ * 有一个间接块时,顺便记下其后有多少项映射到连续的逻辑块上,这样顺序读和按需加载时后面的块就不必再遍历索引树.只缓存已存在的块,
+ * 因此分配新块不会使区段失效 -- 只有truncate()会,它清空缓存并递增i_ext_seq.
+ */
+// 记住文件块block开始的连续区段.zones是该块所在的块号数组(i节点的直接块或间接块),idx是block在其中的索引.seq是开始映射时的
+// i_ext_seq,若映射期间(可能睡眠)文件被截断过,就不记了.
+static void bmap_cache(struct m_inode * inode, unsigned long block,
+	unsigned short * zones, int n, int idx, unsigned short seq)
+{
+	int len;
+
+	if (!zones[idx] || seq != inode->i_ext_seq)
+		return;
+	for (len = 1; idx + len < n; len++)
+		if (zones[idx + len] != zones[idx] + len)
+			break;
+	inode->i_ext_block = block;
+	inode->i_ext_zone = zones[idx];
+	inode->i_ext_len = len;
+}
+
+// 新块的分配目标:紧跟在文件前一块之后(参见bitmap.c中的new_file_block()).前一块不存在时没有目标.
+#define GOAL(prev) ((prev) ? (prev) + 1 : 0)
+
 // 文件数据块映射到盘块的处理操作.(block位图处理函数,bmap - block map)
 // 参数:inode - 文件的i节点指针;block - 文件中的数据块号;create - 创建块标志.该函数把指定的文件数据块block对应到设备上逻辑块上,并返回逻辑块号.
 // 如果创建标志置位,则在设备上对应逻辑块不存在时就申请新磁盘块,返回文件数据块block对应在设备上的逻辑块号(盘块号).
 static int _bmap(struct m_inode * inode, int block, int create)
 {
 	struct buffer_head * bh;
-	int i;
+	int i, goal;
+	unsigned short seq = inode->i_ext_seq;
 
 	// 首先判断参数文件数据块号block的有效性.如果块号小于0,则停机.如果块号大于直接块数 + 间接块数 + 二次间接块数,超出文件系统表示范围,则停机.
 	if (block < 0)
 		panic("_bmap: block<0");
 	if (block >= 7 + 512 + 512 * 512)
 		panic("_bmap: block>big");
+	// 先查块映射缓存.
+	if (block - inode->i_ext_block < inode->i_ext_len)
+		return inode->i_ext_zone + (block - inode->i_ext_block);
 	// 然后根据文件块号的大小值和是否设置了创建标志分别进行处理.如果该块号小于7,则使用直接块表示.如果创建标志置位,并且i节点中对应该块的逻辑块(区段)字段为0,
-	// 则向相应设备申请一磁盘块(逻辑块),并且将盘上逻辑块号(盘块号)填入逻辑块字段中.然后设置i节点改变时间,置i节点已修改标志.最后返回逻辑块号.函数new_block()
+	// 则向相应设备申请一磁盘块(逻辑块),并且将盘上逻辑块号(盘块号)填入逻辑块字段中.然后设置i节点改变时间,置i节点已修改标志.最后返回逻辑块号.函数new_file_block()
 	// 定义在bitmap.c程序中.
 	if (block < 7) {
 		if (create && !inode->i_zone[block])
-			if (inode->i_zone[block] = new_block(inode->i_dev)) {
+			if (inode->i_zone[block] = new_file_block(inode,
+			    block ? GOAL(inode->i_zone[block - 1]) : 0)) {
 				inode->i_ctime = CURRENT_TIME;
 				inode->i_dirt = 1;
 			}
@@ -122,7 +244,7 @@ static int _bmap(struct m_inode * inode, int block, int create)
 	if (block < 512) {
 		// 如果创建标志置位，同时索引7这个位置没有绑定到对应的逻辑块,则申请一个逻辑块
 		if (create && !inode->i_zone[7])
-			if (inode->i_zone[7] = new_block(inode->i_dev)) {
+			if (inode->i_zone[7] = new_file_block(inode, GOAL(inode->i_zone[6]))) {
 				inode->i_dirt = 1;
 				inode->i_ctime = CURRENT_TIME;
 			}
@@ -134,10 +256,12 @@ static int _bmap(struct m_inode * inode, int block, int create)
 			return 0;
 		i = ((unsigned short *) (bh->b_data))[block];
 		if (create && !i)
-			if (i = new_block(inode->i_dev)) {
+			if (i = new_file_block(inode, GOAL(block ?
+			    ((unsigned short *) (bh->b_data))[block - 1] : inode->i_zone[7]))) {
 				((unsigned short *) (bh->b_data))[block] = i;
-				bh->b_dirt = 1;
+				mark_buffer_dirty(bh, inode);
 			}
+		bmap_cache(inode, block + 7, (unsigned short *) bh->b_data, 512, block, seq);
 		// 最后释放该间接块占用的缓冲块,并返回磁盘上新申请或原有的对应block的逻辑块块号.
 		brelse(bh);
 		return i;
@@ -148,7 +272,7 @@ static int _bmap(struct m_inode * inode, int block, int create)
 	// i_zone[8]原来变为0,表明i节点中没有间接块,于是映射磁盘块失败,返回0退出.
 	block -= 512;
 	if (create && !inode->i_zone[8])
-		if (inode->i_zone[8] = new_block(inode->i_dev)) {
+		if (inode->i_zone[8] = new_file_block(inode, GOAL(inode->i_zone[7]))) {
 			inode->i_dirt = 1;
 			inode->i_ctime = CURRENT_TIME;
 		}
@@ -161,9 +285,9 @@ static int _bmap(struct m_inode * inode, int block, int create)
 		return 0;
 	i = ((unsigned short *)bh->b_data)[block >> 9];
 	if (create && !i)
-		if (i = new_block(inode->i_dev)) {
+		if (i = new_file_block(inode, GOAL(inode->i_zone[8]))) {
 			((unsigned short *) (bh->b_data))[block >> 9] = i;
-			bh->b_dirt=1;
+			mark_buffer_dirty(bh, inode);
 		}
 	brelse(bh);
 	// 如果二次间接块的二级块块号为0,表示申请磁盘失败或者原来对应块号就为0,则返回0退出.否则就从设备上读取二次间接块的二级块,并取该二级块上第block项中的逻辑块
@@ -172,14 +296,17 @@ static int _bmap(struct m_inode * inode, int block, int create)
 		return 0;
 	if (!(bh = bread(inode->i_dev, i)))
 		return 0;
+	goal = GOAL(i);
 	i = ((unsigned short *)bh->b_data)[block & 511];
 	// 如果是创建并且二级块的第block项中逻辑块号为0的话,则申请一磁盘块(逻辑块),作为最终存放数据信息的块.并让二级块中的第block项等于该新逻辑块块号(i).然后置位
 	// 二级块的已修改标志.
 	if (create && !i)
-		if (i = new_block(inode->i_dev)) {
+		if (i = new_file_block(inode, (block & 511) ?
+		    GOAL(((unsigned short *) (bh->b_data))[(block & 511) - 1]) : goal)) {
 			((unsigned short *) (bh->b_data))[block & 511] = i;
-			bh->b_dirt = 1;
+			mark_buffer_dirty(bh, inode);
 		}
+	bmap_cache(inode, block + 7 + 512, (unsigned short *) bh->b_data, 512, block & 511, seq);
 	// 最后释放该二次间接块的二级块,返回磁盘上新申请的或原有的对应block的逻辑块块号.
 	brelse(bh);
 	return i;
@@ -224,11 +351,13 @@ void iput(struct m_inode * inode)
 		inode->i_count = 0;
 		inode->i_dirt = 0;
 		inode->i_pipe = 0;
+		put_free(inode, 0);
 		return;
 	}
 	// 如果i节点对应的设备号 =0,则将此节点的引用计数递减1,返回.例如用于管道操作的i节点,其i节点的设备号为0.
 	if (!inode->i_dev) {
-		inode->i_count--;
+		if (!--inode->i_count)
+			put_free(inode, 0);
 		return;
 	}
 	// 如果是块设备文件的i节点,此时逻辑块字段0(i_zone[0])中是设备号,则刷新该设备.并等待i节点解锁.
@@ -253,6 +382,11 @@ repeat:
 	}
 	// 如果该i节点已作过修改,则回写更新该i节点,并等待该i节点解锁.由于这里在写i节点时需要等待睡眠,此时其他进程有可能修改该i节点,因此在进程被唤醒后需要重复
 	// 进行上述判断过程(repeat).
+	// 归还为文件预留的逻辑块(fs/bitmap.c).这可能睡眠,所以也要重复判断.
+	if (inode->i_prealloc_count) {
+		free_prealloc(inode);
+		goto repeat;
+	}
 	if (inode->i_dirt) {
 		write_inode(inode);										/* we can sleep - so do again */
 		wait_on_inode(inode);									/* 因为我们睡眠了,所以要重复判断 */
@@ -261,6 +395,7 @@ repeat:
 	// 程序若能执行到此,说明该i节点的引用计数值i_count是1,链接数不为零,并且内容没有被修改过.因此此时只要把i节点引用计数递减1,返回.此时该i节点的i_count=0,
 	// 表示已释放.
 	inode->i_count--;
+	put_free(inode, 1);
 	return;
 }
 
@@ -269,39 +404,32 @@ repeat:
 struct m_inode * get_empty_inode(void)
 {
 	struct m_inode * inode;
-	static struct m_inode * last_inode = inode_table;			// 指向i节点表第1项.
-	int i;
 
-	// 在初始化last_inode指针指向i节点表头一项后循环扫描整个i节点表,如果last_inode已经指向i节点表的最后1项之后,则让其重新指向i节点表开始处,
-	// 以继续循环寻找空闲i节点项.如果last_inode所指向的i节点计数值为0,则说明可能找到空闲i节点项.让inode指向该i节点.如果该i节点的已修改标志和
-	// 和锁定标志均为0,则我们可以使用该i节点,于是退出for循环.
+	// 从未使用链表头开始寻找,取第一个既没有被修改、没有挂着缓冲块也没有被锁定的i节点.若全都不行,就取链表头一个,把它和挂在
+	// 它名下的缓冲块写盘后重新寻找,免得这些缓冲块丢了主人,以后fsync()找不到它们.因为写盘和等待解锁时可能睡眠,i节点可能又
+	// 被别人使用了,所以每次都要重新开始.
 	do {
-		inode = NULL;
-		for (i = NR_INODE; i ; i--) {							// NR_INODE = 64.
-			if (++last_inode >= inode_table + NR_INODE)
-				last_inode = inode_table;
-			if (!last_inode->i_count) {
-				inode = last_inode;
-				if (!inode->i_dirt && !inode->i_lock)
-					break;
-			}
-		}
-		// 如果没有找到空闲i节点(inode=NULL),则将i节点表打印出来供调试使用,并停机.
-		if (!inode) {
-			for (i = 0 ; i < NR_INODE ; i++)
-				printk("%04x: %6d\t", inode_table[i].i_dev,
-					inode_table[i].i_num);
+		if (!(inode = free_inodes))
 			panic("No free inodes in mem");
-		}
-		// 等待该i节点解锁(如果又被上锁的话).如果该i节点已修改标志被置位的话,则将该i节点刷新(同步).因为刷新时可能会睡眠,因此需要再次循环等待i节点解锁.
+		do {
+			if (!inode->i_dirt && !inode->i_buffers && !inode->i_lock)
+				break;
+			inode = inode->i_next_free;
+		} while (inode != free_inodes);
 		wait_on_inode(inode);
-		while (inode->i_dirt) {
-			write_inode(inode);
+		while (inode->i_dirt || inode->i_buffers) {
+			if (inode->i_dirt)
+				write_inode(inode);
+			sync_inode_buffers(inode);
 			wait_on_inode(inode);
+			if (inode->i_count)
+				break;
 		}
 	} while (inode->i_count);
-	// 如果i节点又被其他占用的话(i节点的计数值不为0了),则重新寻找空闲i节点.否则说明已找到符合要求的空闲i节点项.则将该i节点项内容清零,并置引用计数为1,返回该
-	// i节点指针.
+	// 找到后把它从未使用链表和hash表中取下,将i节点项内容清零,并置引用计数为1,返回该i节点指针.
+	remove_from_free(inode);
+	remove_from_ihash(inode);
+	invalidate_inode_buffers(inode);
 	memset(inode, 0, sizeof(*inode));
 	inode->i_count = 1;
 	return inode;
@@ -320,6 +448,7 @@ struct m_inode * get_pipe_inode(void)
 		return NULL;
 	if (!(inode->i_size = get_free_page())) {         			// 节点的i_size字段指向缓冲区。
 		inode->i_count = 0;
+		put_free(inode, 0);
 		return NULL;
 	}
 	// 然后设置该i节点的引用计数为2,并复位管道头尾指针。i节点逻辑块号数组i_zone[]的i_zone[0]和i_zone[1]中分别用
@@ -336,29 +465,26 @@ struct m_inode * get_pipe_inode(void)
 // 判断处理后返回该i节点指针.否则从设备dev上读取指定i节点号的i节点信息放入i节点表中,并返回该i节点指针.
 struct m_inode * iget(int dev, int nr)
 {
-	struct m_inode * inode, * empty;
+	struct m_inode * inode, * empty = NULL;
 
-	// 首先判断参数有效性.若设备号是0,则表明内核代码问题,显示出错信息并停机.然后预先从i节点表中取一个空闲i节点备用.
+	// 首先判断参数有效性.若设备号是0,则表明内核代码问题,显示出错信息并停机.
 	if (!dev)
 		panic("iget with dev==0");
-	empty = get_empty_inode();
-	// 接着扫描i节点表.寻找参数指定节点号nr的i节点.并递增该节点的引用次数.如果当前扫描i节点的设备号不等于指定的设备号或者节点号不等于指定的节点号,则继续扫描.
-	inode = inode_table;
-	while (inode < NR_INODE + inode_table) {
-		if (inode->i_dev != dev || inode->i_num != nr) {
-			inode++;
-			continue;
-		}
-		// 如果找到指定设备号dev和节点号nr的i节点,则等待该节点解锁(如果已上锁的话).在等待该节点解锁过程中,i节点可能会发生变化.所以再次进行上述相同判断.如果发生
-		// 了变化,则重新扫描整个i节点表.
+	// 接着在hash表中寻找指定设备号dev和节点号nr的i节点.找到后等待该节点解锁(如果已上锁的话).在等待该节点解锁过程中,i节点可能会发生变化,
+	// 所以再次进行相同判断.如果发生了变化,则重新查找.
+repeat:
+	for (inode = ihash(dev, nr) ; inode ; inode = inode->i_hash_next)
+		if (inode->i_dev == dev && inode->i_num == nr)
+			break;
+	if (inode) {
 		wait_on_inode(inode);
-		if (inode->i_dev != dev || inode->i_num != nr) {
-			inode = inode_table;
-			continue;
-		}
-		// 到这里表示找到相应的i节点.于是将该i节点引用计数增1.然后再作进一步检查,看它是否是另一个文件系统的安装点.若是则寻找被安装文件系统根节点并返回.如果该i节点
-		// 的确是其他文件系统的安装点,则在超级块表中搜寻安装在此i节点的超级块.如果没有找到,则显示出错信息,并放回本函数开始时获取的空闲节点empty,返回该i节点指针.
-		inode->i_count++;
+		if (inode->i_dev != dev || inode->i_num != nr)
+			goto repeat;
+		// 到这里表示找到相应的i节点.于是将该i节点引用计数增1(若原来未被使用,则从未使用链表中取下).然后再作进一步检查,看它是否是另一个文件系统
+		// 的安装点.若是则寻找被安装文件系统根节点并返回.如果该i节点的确是其他文件系统的安装点,则在超级块表中搜寻安装在此i节点的超级块.如果没有
+		// 找到,则显示出错信息,并放回空闲节点empty,返回该i节点指针.
+		if (!inode->i_count++)
+			remove_from_free(inode);
 		if (inode->i_mount) {
 			int i;
 
@@ -371,25 +497,28 @@ struct m_inode * iget(int dev, int nr)
 					iput(empty);
 				return inode;
 			}
-			// 执行到这里表示已经找到安装到inode节点的文件系统超级块.于是将该i节点写盘放回,并从安装在此i节点上的文件系统超级块中取设备号,并令i节点号为ROOT_INO.然后
-			// 重新扫描整个i节点表,以获取该被安装文件系统的根i节点信息.
+			// 执行到这里表示已经找到安装到inode节点的文件系统超级块.于是将该i节点放回,并从安装在此i节点上的文件系统超级块中取设备号,并令i节点号
+			// 为ROOT_INO.然后重新查找,以获取该被安装文件系统的根i节点信息.
 			iput(inode);
 			dev = super_block[i].s_dev;
 			nr = ROOT_INO;
-			inode = inode_table;
-			continue;
+			goto repeat;
 		}
-		// 最终我们找到了相应的i节点.因此可以放弃本函数开始处临时 的空闲i节点,返回找到的i节点指针.
+		// 最终我们找到了相应的i节点.因此可以放弃临时取得的空闲i节点,返回找到的i节点指针.
 		if (empty)
 			iput(empty);
 		return inode;
-    }
-	// 如果我们在i节点表中没有找到指定的i节点,则利用前面申请的空闲i节点empty在i节点表中建立该i节点.并从相应设备上读取该i节点信息,返回该i节点指针.
-	if (!empty)
-		return (NULL);
+	}
+	// 没有找到时,取一个空闲i节点.因为get_empty_inode()可能睡眠,其间别人可能已读入了该i节点,所以要重新查找一次.
+	if (!empty) {
+		empty = get_empty_inode();
+		goto repeat;
+	}
+	// 利用空闲i节点empty建立该i节点,放入hash表,并从相应设备上读取该i节点信息,返回该i节点指针.
 	inode = empty;
 	inode->i_dev = dev;									// 设置i节点的设备.
 	inode->i_num = nr;									// 设置i节点号.
+	insert_into_ihash(inode);
 	read_inode(inode);      							// 读取i节点信息
 	return inode;
 }
@@ -466,3 +595,63 @@ static void write_inode(struct m_inode * inode)
 	brelse(bh);
 	unlock_inode(inode);
 }
+
+// 把文件的i节点写到设备上,并等待写操作完成(fs/buffer.c中的fsync()和fdatasync()调用).datasync非0时,如果文件长度和块映射都没有
+// 改变(例如只是修改时间变了),就不写i节点.
+void fsync_inode(struct m_inode * inode, int datasync)
+{
+	struct super_block * sb;
+	struct buffer_head * bh;
+	struct d_inode * d;
+	int block, i;
+
+	if (!inode->i_dev || !(sb = get_super(inode->i_dev)))
+		return;
+	block = 2 + sb->s_imap_blocks + sb->s_zmap_blocks +
+		(inode->i_num - 1) / INODES_PER_BLOCK;
+	if (!(bh = bread(inode->i_dev, block)))
+		return;
+	if (inode->i_dirt) {
+		d = (struct d_inode *) bh->b_data + (inode->i_num - 1) % INODES_PER_BLOCK;
+		i = 9;
+		if (datasync && d->i_size == inode->i_size)
+			for (i = 0 ; i < 9 && d->i_zone[i] == inode->i_zone[i] ; i++)
+				;
+		if (i < 9)
+			write_inode(inode);
+	}
+	// brelse()会等待写操作完成.
+	if (bh->b_dirt)
+		ll_rw_block(WRITE, bh);
+	brelse(bh);
+}
+
+/*
+ * Sets up the in-core inode table at mem_start. We keep one inode per
+ * 8kB of memory, but not less than the old 64. Returns the amount of
+ * memory used, rounded up to a page.
+ */
+/*
+ * 在mem_start处建立内存i节点表.每8KB内存一个i节点,但不少于原来的64个.返回所用的内存量(按页取整).
+ */
+long inode_init(long mem_start, long mem_end)
+{
+	int i;
+
+	nr_inodes = mem_end >> 13;
+	if (nr_inodes < 64)
+		nr_inodes = 64;
+	else if (nr_inodes > 4096)
+		nr_inodes = 4096;
+	for (i = 4 ; (1 << i) < nr_inodes ; i++)
+		/* nothing */ ;
+	NR_IHASH = 1 << i;
+	inode_hash = (struct m_inode **) mem_start;
+	inode_table = (struct m_inode *) (inode_hash + NR_IHASH);
+	memset(inode_hash, 0, NR_IHASH * sizeof(struct m_inode *));
+	memset(inode_table, 0, nr_inodes * sizeof(struct m_inode));
+	for (i = 0 ; i < nr_inodes ; i++)
+		put_free(inode_table + i, 1);
+	return (NR_IHASH * sizeof(struct m_inode *) +
+		nr_inodes * sizeof(struct m_inode) + 4095) & ~4095;
+}
@@ -11,6 +11,7 @@
 #include <linux/sched.h>										// 调试程序头文件,定义了任务结构task_struct,0的数据等.
 //#include <linux/kernel.h>
 #include <asm/segment.h>										// 段操作头文件.定义了有关段寄存器操作的嵌入式汇编函数.
+#include <asm/system.h>
 
 #include <string.h>
 #include <fcntl.h>												// 文件控制头文件.文件及其描述符的操作控制常数符号的定义.
@@ -126,6 +127,336 @@ static int match(int len, const char * name, struct dir_entry * de)
 	return same;							// 返回比较结果.
 }
 
+/*
+ * Hashed directory index. Each index block holds 192 records of the form
+ * (1 << 31 | 21 bits of name hash << 10 | logical block), three in the
+ * name field of every entry, and the name hash picks both the index
+ * block and where to start probing in it. Records are only added:
+ * when a name is removed its record just points at a block that no
+ * longer has it, which costs a wasted read, not a wrong answer.
+ *
+ * The index is only trusted if the directory's mtime and size are what
+ * they were when we last wrote the header, so a kernel that doesn't
+ * know about the index makes us throw it away and build a new one.
+ * All index work is done with the directory inode locked.
+ */
+/*
+ * 目录散列索引.每个索引块有192个记录,格式为(1<<31 | 名字散列值的21位<<10 | 逻辑块号),每个目录项的名字字段中存放3个.名字的散列值
+ * 既用于选择索引块,也决定了在块中开始探查的位置.记录只增不减:名字被删除后,其记录只是指向一个已没有该名字的块,代价是多读一块,而不会
+ * 得到错误的结果.
+ *
+ * 只有当目录的修改时间和大小与我们上次写索引头时相同,索引才是可信的.因此若不认识索引的内核修改了目录,我们就会丢弃旧索引并重建.
+ * 所有的索引操作都在目录i节点上锁的情况下进行.
+ */
+#define DX_MIN_BLOCKS	4						// 目录达到这么多块时才建立索引.
+#define DX_MAX_BLOCKS	1024					// 记录中逻辑块号只有10位.
+#define DX_RECORDS		(3 * DIR_ENTRIES_PER_BLOCK)
+#define DX_HASH(rec)	(((rec) >> 10) & 0x1fffff)
+#define DX_BLOCK(rec)	((rec) & 0x3ff)
+
+#define dx_record(bh, r) ((unsigned long *) \
+	(((struct dir_entry *) (bh)->b_data)[(r) / 3].name + 4 * ((r) % 3)))
+#define dx_slot(bh, r) (((struct dir_entry *) (bh)->b_data)[(r) / 3].inode)
+
+static inline void lock_dir(struct m_inode * dir)
+{
+	cli();
+	while (dir->i_lock)
+		sleep_on(&dir->i_wait);
+	dir->i_lock = 1;
+	sti();
+}
+
+static inline void unlock_dir(struct m_inode * dir)
+{
+	dir->i_lock = 0;
+	wake_up(&dir->i_wait);
+}
+
+// 计算名字的散列值.name在内核空间中.
+static unsigned long dx_hash(const char * name, int len)
+{
+	unsigned long h = 0;
+
+	while (len-- && *name)
+		h = h * 31 + (unsigned char) *name++;
+	return h ^ (h >> 11);
+}
+
+// 取用户空间中名字的散列值.
+static unsigned long dx_hash_user(const char * name, int len)
+{
+	char buf[NAME_LEN];
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = get_fs_byte(name + i);
+	return dx_hash(buf, len);
+}
+
+// 读入目录第1块并取得".."目录项中的索引头.
+static struct buffer_head * dx_get_root(struct m_inode * dir, struct dx_root ** root)
+{
+	struct buffer_head * bh;
+	struct dir_entry * de;
+
+	if (!dir->i_zone[0] || !(bh = bread(dir->i_dev, dir->i_zone[0])))
+		return NULL;
+	de = 1 + (struct dir_entry *) bh->b_data;
+	if (!de->inode || strcmp(de->name, "..")) {
+		brelse(bh);
+		return NULL;
+	}
+	*root = (struct dx_root *) de->name;
+	return bh;
+}
+
+// 把目录当前的修改时间和大小写入索引头,或者(nr为0时)清除索引头.
+static void dx_set_root(struct m_inode * dir, int start, int nr)
+{
+	struct buffer_head * bh;
+	struct dx_root * root;
+
+	if (!(bh = dx_get_root(dir, &root)))
+		return;
+	root->magic = nr ? DX_MAGIC : 0;
+	root->nr_blocks = nr;
+	root->start = start;
+	root->mtime = dir->i_mtime;
+	root->entries = dir->i_size / sizeof (struct dir_entry);
+	bh->b_dirt = 1;
+	brelse(bh);
+}
+
+// 目录i节点读入后第一次使用索引时,检查磁盘上的索引头是否仍然有效.i_dx_checked为2表示无法为该目录建立索引.
+static void dx_check(struct m_inode * dir)
+{
+	struct buffer_head * bh;
+	struct dx_root * root;
+
+	if (dir->i_dx_checked)
+		return;
+	dir->i_dx_checked = 1;
+	dir->i_dx_nr = 0;
+	if (!(bh = dx_get_root(dir, &root)))
+		return;
+	if (root->magic == DX_MAGIC && root->nr_blocks &&
+	    root->mtime == dir->i_mtime &&
+	    root->entries == dir->i_size / sizeof (struct dir_entry) &&
+	    (root->start + root->nr_blocks) * BLOCK_SIZE <= dir->i_size) {
+		dir->i_dx_start = root->start;
+		dir->i_dx_nr = root->nr_blocks;
+	}
+	brelse(bh);
+}
+
+// 丢弃索引.索引块中的目录项此后可以使用,因此空闲目录项提示不能越过它们.
+static void dx_drop(struct m_inode * dir)
+{
+	if (dir->i_dir_hint > dir->i_dx_start * DIR_ENTRIES_PER_BLOCK)
+		dir->i_dir_hint = dir->i_dx_start * DIR_ENTRIES_PER_BLOCK;
+	dir->i_dx_nr = 0;
+	dx_set_root(dir, 0, 0);
+}
+
+// 为逻辑块block中散列值为h的名字加入一条索引记录.索引块已满时返回-1.
+static int dx_insert(struct m_inode * dir, unsigned long h, int block)
+{
+	struct buffer_head * bh;
+	unsigned long * rec;
+	int i, r;
+
+	if (block >= DX_MAX_BLOCKS)
+		return -1;
+	if (!(i = bmap(dir, dir->i_dx_start + h % dir->i_dx_nr)) ||
+	    !(bh = bread(dir->i_dev, i)))
+		return -1;
+	r = (h / dir->i_dx_nr) % DX_RECORDS;
+	for (i = 0; i < DX_RECORDS; i++, r = (r + 1) % DX_RECORDS) {
+		if (dx_slot(bh, r))
+			break;
+		rec = dx_record(bh, r);
+		if (!*rec || *rec == (0x80000000 | ((h & 0x1fffff) << 10) | block)) {
+			*rec = 0x80000000 | ((h & 0x1fffff) << 10) | block;
+			bh->b_dirt = 1;
+			brelse(bh);
+			return 0;
+		}
+	}
+	brelse(bh);
+	return -1;
+}
+
+// 把逻辑块block开始的nr块清零.
+static void dx_clear(struct m_inode * dir, int block, int nr)
+{
+	struct buffer_head * bh;
+	int i;
+
+	while (nr--) {
+		if ((i = bmap(dir, block++)) && (bh = bread(dir->i_dev, i))) {
+			memset(bh->b_data, 0, BLOCK_SIZE);
+			bh->b_dirt = 1;
+			brelse(bh);
+		}
+	}
+}
+
+/*
+ * Build a new index at the end of the directory. Index blocks are zero
+ * filled entries, so add_entry() is told to skip them (i_dx_start and
+ * i_dx_nr) before the directory is extended over them.
+ */
+/*
+ * 在目录末尾建立新的索引.索引块中都是全零的目录项,因此在把目录扩展到它们之前,先设置i_dx_start和i_dx_nr让add_entry()跳过它们.
+ */
+static void dx_build(struct m_inode * dir)
+{
+	struct buffer_head * bh;
+	struct dir_entry * de;
+	int block, nr, count, start, i;
+
+	// 先清除旧索引头,并把旧索引块清零,让它们重新成为空闲目录项.清零期间add_entry()仍然会跳过它们.之后空闲目录项提示不能
+	// 越过这些空闲目录项.
+	dx_set_root(dir, 0, 0);
+	if (dir->i_dx_nr) {
+		dx_clear(dir, dir->i_dx_start, dir->i_dx_nr);
+		dir->i_dx_nr = 0;
+		if (dir->i_dir_hint > dir->i_dx_start * DIR_ENTRIES_PER_BLOCK)
+			dir->i_dir_hint = dir->i_dx_start * DIR_ENTRIES_PER_BLOCK;
+	}
+	// 统计已使用的目录项数,按每个索引块不超过1/3满来确定索引块数.
+	nr = (dir->i_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	count = 0;
+	for (block = 0; block < nr; block++) {
+		if (!(i = bmap(dir, block)) || !(bh = bread(dir->i_dev, i)))
+			continue;
+		de = (struct dir_entry *) bh->b_data;
+		for (i = 0; i < DIR_ENTRIES_PER_BLOCK; i++, de++)
+			if (de->inode)
+				count++;
+		brelse(bh);
+	}
+	start = (dir->i_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	nr = count / DIR_ENTRIES_PER_BLOCK + 1;
+	if (nr > 255 || start + nr > DX_MAX_BLOCKS) {
+		dir->i_dx_checked = 2;						// 目录太大,不再尝试建立索引.
+		return;
+	}
+	dir->i_dx_start = start;
+	dir->i_dx_nr = nr;
+	for (block = start; block < start + nr; block++) {
+		if (!(i = create_block(dir, block)) || !(bh = bread(dir->i_dev, i))) {
+			dir->i_dx_nr = 0;
+			return;
+		}
+		memset(bh->b_data, 0, BLOCK_SIZE);
+		bh->b_dirt = 1;
+		brelse(bh);
+	}
+	if (dir->i_size < (start + nr) * BLOCK_SIZE) {
+		dir->i_size = (start + nr) * BLOCK_SIZE;
+		dir->i_dirt = 1;
+	}
+	// 然后把索引块前面所有已使用的目录项加入索引.索引块后面的目录项是在此期间新加入的,它们的add_entry()正等着把自己加入索引.
+	for (block = 0; block < start; block++) {
+		if (!(i = bmap(dir, block)) || !(bh = bread(dir->i_dev, i)))
+			continue;
+		de = (struct dir_entry *) bh->b_data;
+		for (i = 0; i < DIR_ENTRIES_PER_BLOCK; i++, de++)
+			if (de->inode && dx_insert(dir, dx_hash(de->name, NAME_LEN), block)) {
+				brelse(bh);
+				dir->i_dx_nr = 0;
+				dir->i_dx_checked = 2;
+				return;
+			}
+		brelse(bh);
+	}
+	dx_set_root(dir, start, nr);
+}
+
+/*
+ * Look a name up through the index. Returns 0 if the directory has no
+ * usable index, and 1 otherwise, with *res_bh NULL if the name isn't
+ * there.
+ */
+/*
+ * 通过索引查找名字.若目录没有可用的索引则返回0,否则返回1,名字不存在时*res_bh为NULL.
+ */
+static int dx_find(struct m_inode * dir, const char * name, int namelen,
+	struct buffer_head ** res_bh, struct dir_entry ** res_dir)
+{
+	struct buffer_head * ibh, * bh;
+	struct dir_entry * de;
+	unsigned long h, rec;
+	int i, r, block, ret = 0;
+
+	*res_bh = NULL;
+	if (!namelen || dir->i_size < DX_MIN_BLOCKS * BLOCK_SIZE)
+		return 0;
+	h = dx_hash_user(name, namelen);
+	lock_dir(dir);
+	dx_check(dir);
+	if (!dir->i_dx_nr)
+		goto out;
+	if (!(i = bmap(dir, dir->i_dx_start + h % dir->i_dx_nr)) ||
+	    !(ibh = bread(dir->i_dev, i)))
+		goto out;
+	r = (h / dir->i_dx_nr) % DX_RECORDS;
+	for (i = 0; i < DX_RECORDS; i++, r = (r + 1) % DX_RECORDS) {
+		if (dx_slot(ibh, r)) {						// 索引块被别人当作目录项用了.
+			brelse(ibh);
+			dx_drop(dir);
+			goto out;
+		}
+		if (!(rec = *dx_record(ibh, r))) {			// 探查到空记录,名字不存在.
+			ret = 1;
+			break;
+		}
+		if (DX_HASH(rec) != (h & 0x1fffff))
+			continue;
+		block = bmap(dir, DX_BLOCK(rec));
+		if (!block || !(bh = bread(dir->i_dev, block)))
+			continue;
+		de = (struct dir_entry *) bh->b_data;
+		for (block = 0; block < DIR_ENTRIES_PER_BLOCK; block++, de++)
+			if (match(namelen, name, de)) {
+				*res_bh = bh;
+				*res_dir = de;
+				ret = 1;
+				goto found;
+			}
+		brelse(bh);
+	}
+found:
+	brelse(ibh);
+out:
+	unlock_dir(dir);
+	return ret;
+}
+
+// 把add_entry()新加入逻辑块block中的名字加入索引.目录足够大而还没有索引时就建立索引.调用者已锁定目录.
+static void dx_add(struct m_inode * dir, struct dir_entry * de, int block)
+{
+	dx_check(dir);
+	if (dir->i_dx_nr) {
+		if (dx_insert(dir, dx_hash(de->name, NAME_LEN), block))
+			dx_build(dir);
+		else
+			dx_set_root(dir, dir->i_dx_start, dir->i_dx_nr);
+	} else if (dir->i_dx_checked == 1 && dir->i_size >= DX_MIN_BLOCKS * BLOCK_SIZE)
+		dx_build(dir);
+}
+
+// 目录的修改时间被改变后,更新索引头,免得下次读入目录时把索引当作已过时.
+static void dx_touch(struct m_inode * dir)
+{
+	lock_dir(dir);
+	if (dir->i_dx_nr)
+		dx_set_root(dir, dir->i_dx_start, dir->i_dx_nr);
+	unlock_dir(dir);
+}
+
 /*
  *	find_entry()
  *
@@ -157,6 +488,7 @@ static struct buffer_head * find_entry(struct m_inode ** dir,
 	struct buffer_head * bh;
 	struct dir_entry * de;
 	struct super_block * sb;
+	unsigned long seq;
 
 	// 同样,本函数一开始也需要对函数参数的有效性进行判断和验证.如果我们在前面第30行定义了符号常数NO_TRUNCATE,那么如果文件名长度超过最大长度NAME_LEN,
 	// 则不予处理.如果没有定义过NO_TRUNCATE,那么在文件名长度超过最大长度NAME_LEN时截短之.
@@ -197,6 +529,30 @@ static struct buffer_head * find_entry(struct m_inode ** dir,
 	// 现在我们开始正常操作，查找指定文件名的目录项在什么地方。因此我们需要读取目录的数据，即取出目录i节点对应块设备数据区中的数据块（逻辑块）信息。这些逻辑块的
 	// 块号保存在i节点结构的i_zone[9]数组中.我们先取其中第1个块号.如果目录i节点指向的第一个直接盘块号为0,则说明该目录竟然不含数据,这不正常.于是返回NULL退出.
 	// 否则我们就从节点所在设备读取指定的目录项数据块.当然,如果不成功,则也返回NULL退出.
+	// 先查目录项缓存.若缓存中记录该名字不存在,直接返回NULL.若记录了目录项的位置,则读入该块并再次比较名字,相同就直接返回,否则
+	// 说明缓存项已过时,仍旧扫描整个目录.
+	seq = dcache_seq;
+	if (dcache_lookup(*dir, name, namelen, &block, &i)) {
+		if (!block)
+			return NULL;
+		if ((bh = bread((*dir)->i_dev, block))) {
+			de = (struct dir_entry *) (bh->b_data + i);
+			if (match(namelen, name, de)) {
+				*res_dir = de;
+				return bh;
+			}
+			brelse(bh);
+		}
+	}
+	// 再看目录是否有散列索引,有则直接读入名字所在的块.
+	if (dx_find(*dir, name, namelen, &bh, &de)) {
+		if (bh) {
+			dcache_add(*dir, name, namelen, bh->b_blocknr, (char *) de - bh->b_data);
+			*res_dir = de;
+		} else if (seq == dcache_seq)
+			dcache_add(*dir, name, namelen, 0, 0);
+		return bh;
+	}
 	if (!(block = (*dir)->i_zone[0]))
 		return NULL;
 	if (!(bh = bread((*dir)->i_dev, block)))
@@ -208,10 +564,14 @@ static struct buffer_head * find_entry(struct m_inode ** dir,
 	while (i < entries) {
 		// 如果当前目录项数据块已经搜索完,还没有找到匹配的目录项,则释放当前目录项数据块.再读入目录的下一个逻辑块.若这块为空,则只要还没有搜索完目录中的所有目录项,就
 		// 跳过该块,继续读目录的下一逻辑块.若该块不空,就让de指向该数据块,然后在其中继续搜索.其中141行上i/DIR_ENTRIES_PER_BLOCK可得到当前搜索的目录项所在目录文件中的
-		// 块号,而bmap()函数(inode.c)则可计算出在设备上对应的逻辑块号.
-		if ((char *)de >= BLOCK_SIZE + bh->b_data) {
+		// 块号,而bmap()函数(inode.c)则可计算出在设备上对应的逻辑块号.跳过一块后bh为NULL,此时也要读入下一块.
+		if (!bh || (char *)de >= BLOCK_SIZE + bh->b_data) {
 			brelse(bh);
 			bh = NULL;
+			if ((*dir)->i_dx_nr && i / DIR_ENTRIES_PER_BLOCK == (*dir)->i_dx_start) {
+				i += (*dir)->i_dx_nr * DIR_ENTRIES_PER_BLOCK;	// 跳过索引块.
+				continue;
+			}
 			if (!(block = bmap(*dir, i / DIR_ENTRIES_PER_BLOCK)) ||
 			    !(bh = bread((*dir)->i_dev, block))) {
 				i += DIR_ENTRIES_PER_BLOCK;
@@ -221,14 +581,18 @@ static struct buffer_head * find_entry(struct m_inode ** dir,
 		}
 		// 如果找到匹配的目录项的话,则返回目录项结构指针de和该目录项i节点指针*dir以及该目录项数据块指针bh,并退出函数.否则继续在目录项数据块中比较下一个目录项.
 		if (match(namelen, name, de)) {
+			dcache_add(*dir, name, namelen, bh->b_blocknr, (char *) de - bh->b_data);
 			*res_dir = de;
 			return bh;
 		}
 		de++;
 		i++;
 	}
-	// 如果指定目录中的所有目录项都搜索赛后,还没有找到相应的目录项,则释放目录的数据块,最后返回NULL(失败).
+	// 如果指定目录中的所有目录项都搜索赛后,还没有找到相应的目录项,则释放目录的数据块,最后返回NULL(失败).若扫描期间没有人改动过
+	// 目录项缓存,则记下该名字不存在.
 	brelse(bh);
+	if (seq == dcache_seq)
+		dcache_add(*dir, name, namelen, 0, 0);
 	return NULL;
 }
 
@@ -238,26 +602,26 @@ static struct buffer_head * find_entry(struct m_inode ** dir,
  * adds a file entry to the specified directory, using the same
  * semantics as find_entry(). It returns NULL if it failed.
  *
- * NOTE!! The inode part of 'de' is left at 0 - which means you
- * may not sleep between calling this and putting something into
- * the entry, as someone else might have used it while you slept.
+ * The entry is filled in and put into the directory index with the
+ * directory locked, so dx_find() never sees the slot in use before its
+ * index record exists. The dcache is only invalidated after that.
  */
 /*
  *      add_entry()
  * 使用与find_entry()同样的方法，往指定目录中添加一指定文件名的目录项。如果失败则返回NULL。
  *
- * 注意！！'de'（指定目录项结构指针）的i节点部分被设置为0 - 这表示在调用该函数和往目录项中添加信息之间不能去睡眠，
- * 因为如果睡眠，那么其他人（进程）可能会使用该目录项。
+ * 填写目录项和加入目录索引都在锁定目录期间进行,因此dx_find()不会看到已使用但还没有索引记录的目录项.此后才让目录项缓存失效.
  */
 // 根据指定的目录和文件名添加目录项。
-// 参数：dir - 指定目录的i节点；name - 文件名；namelen - 文件名长度；
+// 参数：dir - 指定目录的i节点；name - 文件名；namelen - 文件名长度；ino - 新目录项的i节点号。
 // 返回：高速缓冲区指针；res_dir - 返回的目录项结构指针。
 static struct buffer_head * add_entry(struct m_inode * dir,
-	const char * name, int namelen, struct dir_entry ** res_dir)
+	const char * name, int namelen, struct dir_entry ** res_dir, int ino)
 {
-	int block, i;
+	int block, i, n;
 	struct buffer_head * bh;
 	struct dir_entry * de;
+	char buf[NAME_LEN];
 
 	// 同样，本函数一开始也需要对函数参数的有效性进行判断和验证。如果我们在前面定义了符号常数NO_TRUNCATE，那么如果文件
 	// 名长度超过最大长度NAME_LEN，则不予处理。如果没有定义过NO_TRUNCATE，那么在文件长度超过最大长度NAME_LEN时截短之。
@@ -275,22 +639,33 @@ static struct buffer_head * add_entry(struct m_inode * dir,
 	// 指定的目录项数据块。如果不成功，则也返回NULL退出。另外，如果参数提供的文件名长度等于0,则也返回NULL退出。
 	if (!namelen)
 		return NULL;
-	if (!(block = dir->i_zone[0]))
-		return NULL;
-	if (!(bh = bread(dir->i_dev, block)))
+	if (!dir->i_zone[0])
 		return NULL;
-	// 此时我们就在这个目录i节点数据块中循环查找最后未使用的空目录项。首先让目录项结构指针de指向缓冲块中的数据块部分，即第
-	// 一个目录项处。其中i是目录中的目录项索引号，在循环开始时初始化为0。
-	i = 0;
-	de = (struct dir_entry *) bh->b_data;
+	// 先把文件名复制到内核空间,免得在锁定目录期间因缺页而睡眠.
+	for (n = 0; n < NAME_LEN ; n++)
+		buf[n] = (n < namelen) ? get_fs_byte(name + n) : 0;
+	// 此时我们就在目录中循环查找未使用的空目录项。i是目录中的目录项索引号，从空闲目录项提示i_dir_hint开始，它前面的目录项都
+	// 已被使用。bh置为NULL，让循环先读入i所在的块。
+	i = dir->i_dir_hint;
+	if (i * sizeof(struct dir_entry) > dir->i_size)
+		i = dir->i_size / sizeof(struct dir_entry);
+	bh = NULL;
+	de = NULL;
 	while (1) {
+		// 跳过目录索引块，它们中的目录项看上去是空闲的，但不能使用。
+		if (dir->i_dx_nr && i / DIR_ENTRIES_PER_BLOCK >= dir->i_dx_start &&
+		    i / DIR_ENTRIES_PER_BLOCK < dir->i_dx_start + dir->i_dx_nr) {
+			brelse(bh);
+			bh = NULL;
+			i = (dir->i_dx_start + dir->i_dx_nr) * DIR_ENTRIES_PER_BLOCK;
+		}
 		// 如果当前目录项数据块已经搜索完毕，但还没有找到需要的空目录项，则释放当前目录项数据块，再读入目录的下一个逻辑块。如果
 		// 对应的逻辑块不存在就创建一块。若读取或创建操作失败则返回空。如果此次读取的磁盘逻辑块数据返回的缓冲块指针为空，说明这
 		// 块逻辑块可能是因为不存在而新创建的空块，则把目录项索引值加上一块逻辑块所能容纳的目录项数DIR_ENTRIES_PER_BLOCK，
 		// 用以跳过该块并继续搜索。否则说明新读入的块上有目录项数据，于是让目录项结构指针de指向该块的缓冲块数据部分，然后在其中
 		// 继续搜索。其中i/DIR_ENTRIES_PER_BLOCK可计算得到当前搜索的目录项i所在目录文件中的块号，而create_block()函数
 		// （inode.c）则可读取或创建出在设备上对应的逻辑块。
-		if ((char *)de >= BLOCK_SIZE + bh->b_data) {
+		if (!bh || (char *)de >= BLOCK_SIZE + bh->b_data) {
 			brelse(bh);
 			bh = NULL;
 			block = create_block(dir, i / DIR_ENTRIES_PER_BLOCK);
@@ -300,7 +675,7 @@ static struct buffer_head * add_entry(struct m_inode * dir,
 				i += DIR_ENTRIES_PER_BLOCK;
 				continue;
 			}
-			de = (struct dir_entry *) bh->b_data;
+			de = i % DIR_ENTRIES_PER_BLOCK + (struct dir_entry *) bh->b_data;
 		}
 		// 如果当前所操作的目录项序号i乘上结构大小所得长度值已经超过目录i节点信息所指出的目录数据长度值i_size，则说明整个目录
 		// 文件数据中没有由于删除文件留下的空目录项，因此我们只能把需要添加的新目录项附加到目录文件数据的末端处。于是对该处目录
@@ -315,11 +690,24 @@ static struct buffer_head * add_entry(struct m_inode * dir,
 		// 若当前搜索的目录项de的i节点为空，则表示找到一个还未使用的空闲目录项或是添加的新目录项。于是更新目录的修改时间为当前
 		// 时间，并从用户数据区复制文件名到该目录项的文件名字段，置含有本目录项的相应高速缓冲块已修改标志。返回该目录项的指针以及
 		// 该高速缓冲块的指针，退出。
+		// 找到后锁定目录.锁定时可能睡眠,期间该目录项可能已被别人使用,或者所在块已变成索引块,此时重新检查.然后更新空闲目录项
+		// 提示,把目录项加入目录索引,解锁后再让目录项缓存中该名字的项失效.
 		if (!de->inode) {
+			lock_dir(dir);
+			if (de->inode || (dir->i_dx_nr &&
+			    i / DIR_ENTRIES_PER_BLOCK >= dir->i_dx_start &&
+			    i / DIR_ENTRIES_PER_BLOCK < dir->i_dx_start + dir->i_dx_nr)) {
+				unlock_dir(dir);
+				continue;
+			}
 			dir->i_mtime = CURRENT_TIME;
-			for (i = 0; i < NAME_LEN ; i++)
-				de->name[i] = (i < namelen) ? get_fs_byte(name + i) : 0;
+			memcpy(de->name, buf, NAME_LEN);
+			de->inode = ino;
 			bh->b_dirt = 1;
+			dir->i_dir_hint = i + 1;
+			dx_add(dir, de, i / DIR_ENTRIES_PER_BLOCK);
+			unlock_dir(dir);
+			dcache_remove(dir, name, namelen);
 			*res_dir = de;
 			return bh;
 		}
@@ -629,7 +1017,7 @@ int open_namei(const char * pathname, int flag, int mode,
 		inode->i_uid = current->euid;
 		inode->i_mode = mode;
 		inode->i_dirt = 1;
-		bh = add_entry(dir, basename, namelen, &de);
+		bh = add_entry(dir, basename, namelen, &de, inode->i_num);
 		// 如果返回的应该含有新目录项的调整缓冲区指针为NULL，则表示添加目录项操作失败。于是将该新i节点的引用连接计数减1,放回该
 		// i节点与目录的i节点并返回出错码退出。否则说明添加目录项操作成功。于是我们来设置该新目录项的一些初始值：置i节点号为新申
 		// 请到的i节点的号码；并置高速缓冲区修改标志。然后释放该高速缓冲区，放回目录的i节点。返回新目录项的i节点指针，并成功退出。
@@ -639,7 +1027,6 @@ int open_namei(const char * pathname, int flag, int mode,
 			iput(dir);
 			return -ENOSPC;
 		}
-		de->inode = inode->i_num;
 		bh->b_dirt = 1;
 		brelse(bh);
 		iput(dir);
@@ -723,7 +1110,7 @@ int sys_mknod(const char * filename, int mode, int dev)
 	inode->i_dirt = 1;
 	// 接着为这个新的i节点在目录中新添加一个目录项。如果失败（包含该目录项的高速缓冲块指针为NULL），则放回目录的i节点；
 	// 把所申请的i节点引用连接计数复位，并放回该i节点，返回出错码退出。
-	bh = add_entry(dir, basename, namelen, &de);
+	bh = add_entry(dir, basename, namelen, &de, inode->i_num);
 	if (!bh) {
 		iput(dir);
 		inode->i_nlinks = 0;
@@ -732,7 +1119,6 @@ int sys_mknod(const char * filename, int mode, int dev)
 	}
 	// 现在添加目录项操作也成功了，于是我们来设置这个目录项内容。令该目录项的i节点字段等于新i节点号，并置高速缓冲区已修
 	// 改标志，放回目录和新的i节点，释放高速缓冲区，最后返回0（成功）。
-	de->inode = inode->i_num;
 	bh->b_dirt = 1;
 	iput(dir);
 	iput(inode);
@@ -785,7 +1171,7 @@ int sys_mkdir(const char * pathname, int mode)
 	inode->i_mtime = inode->i_atime = CURRENT_TIME;
 	// 接着为该新i节点申请一用于保存目录项数据的磁盘块，并令i节点的第一个直接块指针等于该块号。如果申请失败则放回对应目录
 	// 的i节点；复位新申请的i节点连接计数；放回该新的i节点，返回没有空间出错码退出。否则置该新的i节点已修改标志。
-	if (!(inode->i_zone[0] = new_block(inode->i_dev))) {
+	if (!(inode->i_zone[0] = new_block(inode->i_dev, 0))) {
 		iput(dir);
 		inode->i_nlinks--;
 		iput(inode);
@@ -817,7 +1203,7 @@ int sys_mkdir(const char * pathname, int mode)
 	inode->i_dirt = 1;
 	// 现在我们在指定目录中新添加一个目录项，用于存放新建目录的i节点和目录名。如果失败（包含该目录项的高速缓冲区指针为NULL），
 	// 则放回目录的i节点；所申请的i节点引用连接计数复位，并放回该i节点。返回出错码退出。
-	bh = add_entry(dir, basename, namelen, &de);
+	bh = add_entry(dir, basename, namelen, &de, inode->i_num);
 	if (!bh) {
 		iput(dir);
 		inode->i_nlinks = 0;
@@ -825,7 +1211,6 @@ int sys_mkdir(const char * pathname, int mode)
 		return -ENOSPC;
 	}
 	// 最后令该新目录项的i节点字段等于新i节点号，并置高速缓冲块已修改标志，放回目录和新的i节点，释放高速缓冲区，最后返回0（成功）。
-	de->inode = inode->i_num;
 	bh->b_dirt = 1;
 	dir->i_nlinks++;
 	dir->i_dirt = 1;
@@ -994,6 +1379,9 @@ int sys_rmdir(const char * name)
 	de->inode = 0;
 	bh->b_dirt = 1;
 	brelse(bh);
+	dcache_remove(dir, basename, namelen);
+	dcache_invalidate_dir(inode);
+	dir->i_dir_hint = 0;
 	inode->i_nlinks = 0;
 	inode->i_dirt = 1;
 	// 再将包含被删除目录名的目录的i节点链接计数减1,修改其改变时间和修改时间为当前时间，并置该节点已修改标志。最后放回包含要删除
@@ -1001,6 +1389,7 @@ int sys_rmdir(const char * name)
 	dir->i_nlinks--;
 	dir->i_ctime = dir->i_mtime = CURRENT_TIME;
 	dir->i_dirt = 1;
+	dx_touch(dir);
 	iput(dir);
 	iput(inode);
 	return 0;
@@ -1076,6 +1465,8 @@ int sys_unlink(const char * name)
 	de->inode = 0;
 	bh->b_dirt = 1;
 	brelse(bh);
+	dcache_remove(dir, basename, namelen);
+	dir->i_dir_hint = 0;								// 空出的目录项位置不知道,只好从头找.
 	// 然后把文件名对应i节点的链接数减1,置已修改标志，更新改变时间为当前时间。最后放回该i节点和目录的i节点，返回0（成功）。如果
 	// 是文件的最后一个链接，即i节点链接数减1后等于0,并且此时没有进程正打开该文件，那么在调用iput()放回i节点时，该文件也将被删除
 	// 并释放所占用的设备空间。参见fs/inode.c。
@@ -1125,7 +1516,7 @@ int sys_symlink(const char * oldname, const char * newname)
 	// 为了保存符号链接路径名字符串信息，我们需要为该i节点申请一个磁盘块，并让i节点的第1个直接块号i_zone[0]等于得到的逻辑块号。
 	// 然后置i节点已修改标志。如果申请失败则放回对应目录的i节点；复位新申请的i节点链接计数；放回该新的i节点，返回没有空间出错码
 	// 退出。
-	if (!(inode->i_zone[0] = new_block(inode->i_dev))) {
+	if (!(inode->i_zone[0] = new_block(inode->i_dev, 0))) {
 		iput(dir);
 		inode->i_nlinks--;
 		iput(inode);
@@ -1164,7 +1555,7 @@ int sys_symlink(const char * oldname, const char * newname)
 	}
 	// 现在我们在指定目录中新添加一个目录项，用于存放新建符号链接文件名的i节点号和目录名。如果失败（包含该目录项的高速缓冲区指针为
 	// NULL），则放回目录的i节点；所申请的i节点引用链接计数复位，并放回该i节点。返回出错码退出。
-	bh = add_entry(dir, basename, namelen, &de);
+	bh = add_entry(dir, basename, namelen, &de, inode->i_num);
 	if (!bh) {
 		inode->i_nlinks--;
 		iput(inode);
@@ -1172,7 +1563,6 @@ int sys_symlink(const char * oldname, const char * newname)
 		return -ENOSPC;
 	}
 	// 最后令该新目录项的i节点字段等于新i节点号，并置高速缓冲块已修改标志，释放高速缓冲块，放回目录和新的i节点，最后返回0（成功）。
-	de->inode = inode->i_num;
 	bh->b_dirt = 1;
 	brelse(bh);
 	iput(dir);
@@ -1237,13 +1627,12 @@ int sys_link(const char * oldname, const char * newname)
 	}
 	// 现在所有条件都满足了，于是我们在新目录中添加一个目录项。若失败则放回该目录的i节点和原路径名的i节点，返回出错号。否则初始
 	// 设置该目录项的i节点号等于原路径名的i节点号，并置包含该新添目录的缓冲块已修改标志，释放该缓冲块，放回目录的i节点。
-	bh = add_entry(dir, basename, namelen, &de);
+	bh = add_entry(dir, basename, namelen, &de, oldinode->i_num);
 	if (!bh) {
 		iput(dir);
 		iput(oldinode);
 		return -ENOSPC;
 	}
-	de->inode = oldinode->i_num;
 	bh->b_dirt = 1;
 	brelse(bh);
 	iput(dir);
@@ -309,6 +309,9 @@ int sys_open(const char * filename, int flag, int mode)
 	f->f_count = 1;
 	f->f_inode = inode;
 	f->f_pos = 0;
+	f->f_ra_pos = 0;
+	f->f_ra_end = 0;
+	f->f_ra_window = 0;
 	return (fd);
 }
 
@@ -124,6 +124,7 @@ void put_super(int dev)
 	// 超级块。然后释放该超级块占用的其他内核资源，即释放该设备上文件系统i节点位图和逻辑位图在缓冲区中所占用的缓冲块。下面
 	// 常数符号I_MAP_SLOTS和Z_MAP_SLOTS均等于8，用于分别指明i节点位图和逻辑块位图占用的磁盘逻辑块数。注意，若这些缓冲块
 	// 内容被修改过，则需要作同步操作才能把缓冲块中的数据写入设备中。函数最后对该超级块，并返回。
+	dcache_invalidate_dev(dev);						// 该设备上的目录项缓存都已失效。
 	lock_super(sb);
 	sb->s_dev = 0;                          		// 置超级块空闲。
 	for(i = 0; i < I_MAP_SLOTS; i++)
@@ -218,6 +219,7 @@ static struct super_block * read_super(int dev)
 	// 1,以防止文件系统分配0号i节点.同样的道理,也将逻辑块位图的最低位设置为1.最后函数解锁该超级块,并返回超级块指针.
 	s->s_imap[0]->b_data[0] |= 1;
 	s->s_zmap[0]->b_data[0] |= 1;
+	count_free_zones(s);
 	free_super(s);
 	return s;
 }
@@ -254,7 +256,7 @@ int sys_umount(char * dev_name)
 		return -ENOENT;
 	if (!sb->s_imount->i_mount)
 		printk("Mounted inode has i_mount=0\n");
-	for (inode = inode_table + 0 ; inode < inode_table + NR_INODE ; inode++)
+	for (inode = inode_table + 0 ; inode < inode_table + nr_inodes ; inode++)
 		if (inode->i_dev == dev && inode->i_count)
 				return -EBUSY;
 	// 现在该设备上文件系统的卸载条件均得到满足，因此我们可以开始实施真正的卸载操作了。首先复位被安装到的i节点的安装标志，释放该
@@ -321,6 +323,7 @@ int sys_mount(char * dev_name, char * dir_name, int rw_flag)
 	}
 	// 最后设置被安装文件系统超级块的“被安装到i节点”字段指向安装到的目录名的i节点。并设置安装位置i节点的安装标志和节点已修改
 	// 标志。然后返回0（安装成功）。
+	dcache_invalidate_dev(dev);
 	sb->s_imount = dir_i;
 	dir_i->i_mount = 1;
 	dir_i->i_dirt = 1;									/* NOTE! we don't iput(dir_i) */        /* 注意！这里没有用iput(dir_i) */
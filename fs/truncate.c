@@ -83,7 +83,11 @@ void truncate(struct m_inode * inode)
 	     S_ISLNK(inode->i_mode)))
 		return;
 	// 然后释放i节点的7个直接逻辑块，并将这7个逻辑块项全置零。函数free_block()用于释放设备上指定逻辑块的磁盘块
-	// （fs/bitmap.c）。若有逻辑块忙而没有被释放则置块忙标志block_busy。
+	// （fs/bitmap.c）。若有逻辑块忙而没有被释放则置块忙标志block_busy。释放前后都要清空块映射缓存(fs/inode.c),
+	// 因为释放过程中可能睡眠,其间别的进程的bmap()可能又把将要释放的块缓存起来。
+	inode->i_ext_len = 0;
+	inode->i_ext_seq++;
+	free_prealloc(inode);
 repeat:
 	block_busy = 0;
 	for (i = 0; i < 7; i++)
@@ -109,6 +113,8 @@ repeat:
 		schedule();
 		goto repeat;
 	}
+	inode->i_ext_len = 0;
+	inode->i_ext_seq++;
 	inode->i_size = 0;                      					// 文件大小置零。
 	// 最后重新置文件修改时间和i节点改变时间为当前时间。宏CURRENT_TIME定义在头文件include/linux/sched.h中，定义
 	// 为（startup_time+jiffies/HZ）。用于取得从1970:0:0:0开始到现在为止经过的秒数。
@@ -60,6 +60,50 @@ static inline void put_fs_long(unsigned long val,unsigned long * addr)
 __asm__ ("movl %0,%%fs:%1"::"q" (val),"m" (*addr));
 }
 
+//// 从内核数据段的from处复制n个字节到fs段的to处.
+// 先复制零头的1个字节和1个字(使剩余长度为4的倍数),再用rep movsl按长字复制.目的串指令使用es段,因此复制期间临时把es设置成fs.
+static inline void memcpy_tofs(void * to, const void * from, unsigned long n)
+{
+	int d0, d1, d2;
+
+	__asm__ __volatile__("cld\n\t"
+		"push %%es\n\t"
+		"push %%fs\n\t"
+		"pop %%es\n\t"
+		"testb $1,%%cl\n\t"
+		"je 1f\n\t"
+		"movsb\n"
+		"1:\ttestb $2,%%cl\n\t"
+		"je 2f\n\t"
+		"movsw\n"
+		"2:\tshrl $2,%%ecx\n\t"
+		"rep ; movsl\n\t"
+		"pop %%es"
+		:"=&c" (d0), "=&D" (d1), "=&S" (d2)
+		:"0" (n), "1" ((long) to), "2" ((long) from)
+		:"memory");
+}
+
+//// 从fs段的from处复制n个字节到内核数据段的to处.
+// 与上面类似,源串指令可以使用段超越前缀,因此直接在movs指令前加fs前缀即可.
+static inline void memcpy_fromfs(void * to, const void * from, unsigned long n)
+{
+	int d0, d1, d2;
+
+	__asm__ __volatile__("cld\n\t"
+		"testb $1,%%cl\n\t"
+		"je 1f\n\t"
+		"fs ; movsb\n"
+		"1:\ttestb $2,%%cl\n\t"
+		"je 2f\n\t"
+		"fs ; movsw\n"
+		"2:\tshrl $2,%%ecx\n\t"
+		"rep ; fs ; movsl"
+		:"=&c" (d0), "=&D" (d1), "=&S" (d2)
+		:"0" (n), "1" ((long) to), "2" ((long) from)
+		:"memory");
+}
+
 /*
  * Someone who knows GNU asm better than I should double check the followig.
  * It seems to work, but I don't know if I'm doing something subtly wrong.
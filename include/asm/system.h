@@ -22,6 +22,12 @@ __asm__ (\
 #define cli() __asm__ ("cli"::)										// 关中断.
 #define nop() __asm__ ("nop"::)										// 空操作.
 
+// 保存/恢复标志寄存器(含中断允许标志).用于既可能在中断中也可能在进程中执行的代码段:save_flags(x);cli();...;restore_flags(x);
+#define save_flags(x) \
+__asm__ __volatile__ ("pushfl ; popl %0":"=r" (x)::"memory")
+#define restore_flags(x) \
+__asm__ __volatile__ ("pushl %0 ; popfl"::"r" (x):"memory")
+
 #define iret() __asm__ ("iret"::)									// 中断返回
 
 // 设置门描述符宏.
@@ -0,0 +1,55 @@
+/*
+ * Block I/O tracing: the event records and statistics returned by the
+ * blktrace() system call (see kernel/blk_drv/blktrace.c).
+ */
+/*
+ * 块设备I/O跟踪:blktrace()系统调用返回的事件记录和统计信息(参见kernel/blk_drv/blktrace.c).
+ */
+#ifndef _BLKTRACE_H
+#define _BLKTRACE_H
+
+#define BLKTRACE_SIZE	256		// 事件环形缓冲区的项数.
+#define BLKTRACE_MAJORS	7		// 统计的主设备数(同NR_BLK_DEV).
+#define BLK_HIST_SLOTS	16		// 直方图的槽数.第n槽(n>0)统计值在[2^(n-1), 2^n)范围内的次数,第0槽统计值为0的次数.
+
+// 事件类型.
+#define BLK_TA_QUEUE	0		// make_request()收到一个缓冲块.
+#define BLK_TA_MERGE	1		// 缓冲块被合并到已有的请求项中.
+#define BLK_TA_INSERT	2		// 新请求项加入设备请求队列(add_request()).
+#define BLK_TA_ISSUE	3		// 请求项成为当前请求项,交给驱动程序处理.
+#define BLK_TA_COMPLETE	4		// 请求项全部完成(end_request()).
+
+// blktrace()系统调用的功能号.
+#define BLKTRACE_READ	0		// 读出尚未读过的事件记录.
+#define BLKTRACE_STAT	1		// 取统计信息(struct blk_trace_info).
+#define BLKTRACE_RESET	2		// 清除事件缓冲区和统计信息.
+
+// 事件记录.
+struct blk_trace_event {
+	unsigned long time;			// 事件发生时间(jiffies).
+	unsigned long sector;		// 起始扇区.
+	unsigned short dev;			// 设备号.
+	unsigned short nr_sectors;	// 扇区数.
+	unsigned char action;		// 事件类型(BLK_TA_*).
+	unsigned char cmd;			// READ或WRITE.
+	unsigned short depth;		// 事件发生时该设备已占用的请求项数(队列深度).
+};
+
+// 每个主设备的统计信息.
+struct blk_trace_stat {
+	unsigned long bt_requests;		// 完成的请求项数.
+	unsigned long bt_sectors;		// 完成的扇区数.
+	unsigned long bt_merges;		// 合并的缓冲块数.
+	unsigned long bt_lat_total;		// 请求项从加入队列到完成的总时间(滴答).
+	unsigned long bt_lat_hist[BLK_HIST_SLOTS];		// 请求项延迟(滴答)直方图.
+	unsigned long bt_depth_hist[BLK_HIST_SLOTS];	// 加入请求项时队列深度直方图.
+	unsigned long bt_poll_spins;	// 驱动程序轮询设备状态的循环次数.
+	unsigned long bt_poll_defers;	// 设备未就绪而推迟到定时器中再轮询的次数.
+};
+
+struct blk_trace_info {
+	unsigned long bt_lost;			// 因缓冲区满而被覆盖掉的事件数.
+	struct blk_trace_stat bt_stat[BLKTRACE_MAJORS];
+};
+
+#endif
@@ -31,6 +31,29 @@
  * 根文件系统设备已不再是硬编码的了.通过修改boot/bootsect.s文件中行ROOT_DEV=XXX,你可以改变根设备的默认设置值.
  */
 
+/*
+ * Bitmap of block-device majors that use the deadline I/O scheduler
+ * (see kernel/blk_drv/elevator.c). All others use the elevator. This is
+ * only the default: a non-zero word at offset 504 of the boot sector
+ * (SCHED_MAJORS in the Makefile) overrides it at boot.
+ */
+/*
+ * 使用deadline I/O调度程序的块设备主设备号位图(参见kernel/blk_drv/elevator.c),其他设备使用电梯调度程序.
+ * 默认硬盘(主设备号3)使用deadline调度程序,以限制大量写盘时读操作的等待时间.这只是默认值:引导扇区504,505字节处的字
+ * (由Makefile中的SCHED_MAJORS写入)不为0时,启动时使用该字.
+ */
+#define DEADLINE_MAJORS	(1 << 3)
+
+/*
+ * Keep the hard disk's write cache on. sync(), fsync() and sync_dev()
+ * end with a barrier that flushes it, so data is on the platter when
+ * they return.
+ */
+/*
+ * 打开硬盘的写缓存.sync(),fsync()和sync_dev()最后都会发出一个刷新驱动器缓存的屏障请求,返回时数据已确实写到盘上.定义为0则关闭写缓存.
+ */
+#define HD_WRITE_CACHE	1
+
 /*
  * The keyboard is now defined in kernel/chr_dev/keyboard.S
  */
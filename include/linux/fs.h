@@ -57,10 +57,9 @@ void buffer_init(long buffer_end);						// 高速缓冲区初始化函数.
 #define SUPER_MAGIC 0x137F								// 文件系统魔数.
 
 #define NR_OPEN 		20								// 进程最多打开文件数.
-#define NR_INODE 		64								// 系统同时最多使用I节点个数.
 #define NR_FILE 		64								// 系统最多文件个数(文件数组项数).
 #define NR_SUPER 		8								// 系统所含超级块个数(超级块数组项数).
-#define NR_HASH 		307								// 缓冲区Hash表数组项数值.
+#define NR_HASH 		nr_hash							// 缓冲区Hash表数组项数值(2的幂).初始化后不再改变.
 #define NR_BUFFERS 		nr_buffers						// 系统所含缓冲个数.初始化后不再改变.
 #define BLOCK_SIZE 		1024							// 数据块长度(字节值)
 #define BLOCK_SIZE_BITS 10								// 数据块长度所占比特位数.
@@ -97,11 +96,50 @@ struct buffer_head {
 	unsigned char b_dirt;								/* 0-clean,1-dirty */	// 修改标志:0未修改,1已修改.
 	unsigned char b_count;								/* users using this block */	// 使用用户数.
 	unsigned char b_lock;								/* 0 - ok, 1 -locked */	// 缓冲区是否被锁定.
+	unsigned char b_list;								// 所在的空闲LRU链表(BUF_CLEAN等),仅当b_count=0时有效.
+	unsigned long b_flushtime;							// 已修改块应被回写任务写盘的时刻(滴答数),0表示未设置.
 	struct task_struct * b_wait;						// 指向等待该缓冲区解锁的任务.
 	struct buffer_head * b_prev;						// hash队列上前一块(这四个指针用于缓冲区的管理).
 	struct buffer_head * b_next;						// hash队列上下一块.
 	struct buffer_head * b_prev_free;					// 空闲表上前一块.
 	struct buffer_head * b_next_free;					// 空闲表上后一块.
+	struct buffer_head * b_reqnext;						// 同一请求项中的下一缓冲块(参见kernel/blk_drv/ll_rw_blk.c).
+	struct m_inode * b_inode;							// 该块所属文件的i节点,块挂在其i_buffers链表中(参见fs/buffer.c).
+	struct buffer_head * b_inode_next;					// i节点缓冲块链表.
+	struct buffer_head * b_inode_prev;
+};
+
+// 引用计数为0的缓冲块按其状态分别挂在以下三个LRU链表中(参见fs/buffer.c).
+#define BUF_CLEAN		0								// 干净且未锁定,可立即重用.
+#define BUF_LOCKED		1								// 释放时仍有I/O操作在进行.
+#define BUF_DIRTY		2								// 已修改,重用前需要写盘.
+#define NR_LIST			3
+#define BUF_RAMDISK		NR_LIST							// 虚拟盘缓冲块:数据就在虚拟盘内存中,不在任何链表上(参见rd_getblk()).
+
+// 高速缓冲统计信息(系统调用bufstat()返回给用户程序).
+struct buffer_stat {
+	unsigned long bs_nr_buffers;						// 缓冲块总数.
+	unsigned long bs_nr_free[NR_LIST];					// 各LRU链表中的缓冲块数.
+	unsigned long bs_lookups;							// getblk()调用次数.
+	unsigned long bs_hits;								// 在hash表中找到的次数.
+	unsigned long bs_clean_victims;						// 直接取到干净缓冲块的次数.
+	unsigned long bs_locked_victims;					// 只能等待锁定缓冲块的次数.
+	unsigned long bs_dirty_victims;						// 不得不选用已修改缓冲块的次数.
+	unsigned long bs_refiles;							// 缓冲块因状态变化而重新归类的次数.
+	unsigned long bs_flushed;							// 回写任务写出的缓冲块数.
+	unsigned long bs_hash_size;							// hash表项数.
+	unsigned long bs_hash_used;							// 非空的hash表项数.
+	unsigned long bs_hash_entries;						// hash表中的缓冲块数.
+	unsigned long bs_hash_maxchain;						// 最长hash链的长度.
+	unsigned long bs_hash_lookups;						// hash表查找次数.
+	unsigned long bs_hash_probes;						// 查找时比较过的缓冲块总数.
+};
+
+// 目录项缓存统计信息(系统调用dcachestat()返回给用户程序,参见fs/dcache.c).
+struct dcache_stat {
+	unsigned long ds_hits;								// 目录项缓存命中次数.
+	unsigned long ds_neg_hits;							// 命中"名字不存在"缓存项的次数.
+	unsigned long ds_misses;							// 目录项缓存未命中次数.
 };
 
 // 磁盘上的索引节点(i节点)数据结构.
@@ -139,6 +177,21 @@ struct m_inode {
 	unsigned char i_mount;								// 安装标志.
 	unsigned char i_seek;								// 搜寻标志(lseek时).
 	unsigned char i_update;								// 更新标志.
+	unsigned char i_dx_nr;								// 目录散列索引块数,0表示没有可用的索引(fs/namei.c).
+	unsigned char i_dx_checked;							// 已检查过磁盘上的索引头.
+	unsigned short i_dx_start;							// 索引的起始逻辑块号.
+	unsigned short i_dir_hint;							// 在此之前的目录项都已使用(add_entry()从这里开始找空项).
+	unsigned long i_ext_block;							// 块映射缓存:从文件块i_ext_block开始的i_ext_len块
+	unsigned short i_ext_zone;							// 连续存放在从i_ext_zone开始的逻辑块中(fs/inode.c).
+	unsigned short i_ext_len;							// 0表示缓存为空.
+	unsigned short i_ext_seq;							// 截断文件时递增.
+	unsigned short i_prealloc_block;					// 为文件预留的下一个逻辑块(fs/bitmap.c).
+	unsigned short i_prealloc_count;					// 预留的逻辑块数.
+	struct buffer_head * i_buffers;						// 修改过的该文件数据块和间接块链表,fsync()只写这些块(fs/buffer.c).
+	struct m_inode * i_hash_next;						// i节点hash链(fs/inode.c).
+	struct m_inode * i_hash_prev;
+	struct m_inode * i_next_free;						// 未使用i节点LRU链表.
+	struct m_inode * i_prev_free;
 };
 
 // 文件结构(用于在文件句柄与i节点之间建立关系).
@@ -148,6 +201,10 @@ struct file {
 	unsigned short f_count;								// 对应文件引用计数值.
 	struct m_inode * f_inode;							// 指向对应i节点.
 	off_t f_pos;										// 文件位置(读写偏移值).
+	/* read-ahead state, see fs/file_dev.c */
+	off_t f_ra_pos;										// 上次读操作结束的位置,从此处开始读即为顺序读.
+	unsigned long f_ra_end;								// 已发出预读请求的文件块号上界(不含).
+	unsigned short f_ra_window;							// 当前预读窗口大小(块数),0表示随机访问.
 };
 
 // 内存中磁盘超级块结构.
@@ -171,6 +228,8 @@ struct super_block {
 	unsigned char s_lock;								// 被锁定标志.
 	unsigned char s_rd_only;							// 只读标志.
 	unsigned char s_dirt;								// 已修改(脏)标志.
+	long s_zfree;										// 空闲逻辑块数(fs/bitmap.c).
+	int s_zhint;										// 逻辑块位图中此位之前没有空闲块.
 };
 
 // 磁盘上超级块结构.
@@ -191,11 +250,36 @@ struct dir_entry {
 	char name[NAME_LEN];								// 文件名,长度NAME_LEN=14.
 };
 
-extern struct m_inode inode_table[NR_INODE];            // 定义i节点表数组(64项).
+/*
+ * Large directories may carry a hashed index. Its header lives in the
+ * unused tail of the ".." name, and the index blocks are part of the
+ * directory but consist of entries with inode 0 only, so code that
+ * doesn't know about the index just sees free entries.
+ */
+/*
+ * 大目录可以带有一个散列索引.索引头存放在".."目录项名字中未用的后部,索引块本身是目录的一部分,但其中所有目录项的i节点号都为0,
+ * 因此不认识索引的代码只会把它们看作空闲目录项.
+ */
+#define DX_MAGIC		0xd1							// 索引头魔数.
+
+struct dx_root {
+	char dotdot[3];										// "..\0".
+	unsigned char magic;								// DX_MAGIC.
+	unsigned char nr_blocks;							// 索引块数.
+	unsigned short start;								// 索引起始逻辑块号.
+	unsigned long mtime;								// 建立或更新索引时目录的修改时间.
+	unsigned short entries;								// 当时目录的目录项数(i_size/16).
+	char unused;
+} __attribute__ ((packed));
+
+extern struct m_inode * inode_table;                    // i节点表数组,大小在启动时确定(fs/inode.c).
+extern int nr_inodes;                                   // i节点表项数.
 extern struct file file_table[NR_FILE];                 // 文件表数组(64项).
 extern struct super_block super_block[NR_SUPER];        // 超级块数组(8项).
 extern struct buffer_head * start_buffer;              	// 缓冲区起始内存位置.
 extern int nr_buffers;
+extern int nr_hash;
+extern struct buffer_stat buffer_stat;					// 高速缓冲统计信息.
 
 // 磁盘操作函数原型。
 extern void check_disk_change(int dev);                         // 检测驱动器中软盘是否改变。
@@ -210,23 +294,43 @@ extern void wait_on(struct m_inode * inode);                    // 等待指定
 extern int bmap(struct m_inode * inode,int block);              // 逻辑块（区段，磁盘块）位图操作。取数据块block在设备上对应的逻辑块号。
 extern int create_block(struct m_inode * inode,int block);      // 创建数据块block在设备上对应的逻辑块，并返回在设备上的逻辑块号。
 
+extern int dcache_lookup(struct m_inode * dir, const char * name, int len,
+	int * block, int * offset);                                 // 在目录项缓存中查找名字(fs/dcache.c).
+extern void dcache_add(struct m_inode * dir, const char * name, int len,
+	int block, int offset);                                     // 把名字的位置加入目录项缓存.
+extern void dcache_remove(struct m_inode * dir, const char * name, int len);
+extern void dcache_invalidate_dir(struct m_inode * dir);       // 删除目录的所有缓存项.
+extern void dcache_invalidate_dev(int dev);                     // 删除设备的所有缓存项.
+extern unsigned long dcache_seq;
 extern struct m_inode * namei(const char * pathname);           // 获取指定路径名的i节点号.
 extern struct m_inode * lnamei(const char * pathname);          // 取指定路径名的i节点，不跟随符号链接。
 extern int open_namei(const char * pathname, int flag, int mode,
 	struct m_inode ** res_inode);                           	// 根据路径名为打开文件操作作准备。
 extern void iput(struct m_inode * inode);                       // 释放一个i节点（回写入设备）。
 extern struct m_inode * iget(int dev,int nr);                   // 从设备读取指定节点号的一个i节点.
+extern void insert_into_ihash(struct m_inode * inode);         // 把i节点放入hash表。
+extern void clear_inode(struct m_inode * inode);                // 清空并释放一个i节点项。
 extern struct m_inode * get_empty_inode(void);                  // 从i节点表（inode_table）中获取一个空闲i节点项。
 extern struct m_inode * get_pipe_inode(void);                   // 获取（申请一）管道节点。返回为i节点指针（如果是NULL则失败）。
 extern struct buffer_head * get_hash_table(int dev, int block); // 在哈希表中查找指定的数据块。返回找到的缓冲头指针。
 extern struct buffer_head * getblk(int dev, int block);         // 从设备读取指定块(首先会在hash表中查找).
 extern void ll_rw_block(int rw, struct buffer_head * bh);       // 读/写数据块。
 extern void ll_rw_page(int rw, int dev, int nr, char * buffer); // 读/写数据页面，即每次4块数据块。
+extern struct buffer_head * rd_getblk(int dev, int block);     // 取虚拟盘块的缓冲头(blk_drv/ramdisk.c)。
+extern void ll_rw_flush(int dev);                               // 等待已提交的写操作完成并刷新驱动器写缓存。
 extern void brelse(struct buffer_head * buf);                   // 释放指定缓冲块。
+extern void mark_buffer_dirty(struct buffer_head * bh, struct m_inode * inode); // 置缓冲块已修改标志,并记在文件inode名下。
+extern void invalidate_inode_buffers(struct m_inode * inode);   // 取下挂在i节点上的所有缓冲块。
+extern void sync_inode_buffers(struct m_inode * inode);         // 写出挂在i节点上的已修改缓冲块。
+extern void fsync_inode(struct m_inode * inode, int datasync);  // 把文件的i节点写到设备上。
 extern struct buffer_head * bread(int dev,int block);           // 读取指定的数据块.
 extern void bread_page(unsigned long addr,int dev,int b[4]);    // 读取设备上一个页面(4个缓冲块)的内容到指定内存地址处。
 extern struct buffer_head * breada(int dev,int block,...);      // 读取头一个指定的数据块,并标记后续将要读的块.
-extern int new_block(int dev);                                  // 向设备dev申请一个磁盘块（区段，逻辑块）。返回逻辑块号。
+extern void bread_ahead(int dev, int block);                     // 预读指定的数据块,不等待读操作完成.
+extern int new_block(int dev, int goal);                        // 向设备dev申请一个尽量靠近goal的磁盘块（逻辑块）。返回逻辑块号。
+extern int new_file_block(struct m_inode * inode, int goal);    // 为文件申请一个尽量靠近goal的磁盘块,并预留其后的空闲块。
+extern void free_prealloc(struct m_inode * inode);              // 释放为文件预留的磁盘块。
+extern void count_free_zones(struct super_block * sb);          // 统计空闲逻辑块数并设置分配提示。
 extern int free_block(int dev, int block);                      // 释放设备数据区中的逻辑块（区段，逻辑块）block。
 extern struct m_inode * new_inode(int dev);                     // 为设备dev建立一个新i节点，返回i节点号。
 extern void free_inode(struct m_inode * inode);                 // 释放一个i节点（删除文件时）。
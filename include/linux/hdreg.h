@@ -46,6 +46,36 @@
 #define WIN_SEEK 		0x70		// 寻道
 #define WIN_DIAGNOSE	0x90		// 控制器诊断
 #define WIN_SPECIFY		0x91		// 建立驱动器参数
+#define WIN_MULTREAD	0xC4		// 多扇区读(每次中断传输一组扇区).
+#define WIN_MULTWRITE	0xC5		// 多扇区写.
+#define WIN_SETMULT		0xC6		// 设置多扇区模式每组的扇区数.
+#define WIN_IDENTIFY	0xEC		// 取驱动器标识信息(512字节).
+#define WIN_READDMA		0xC8		// DMA读扇区.
+#define WIN_WRITEDMA	0xCA		// DMA写扇区.
+#define WIN_FLUSH_CACHE	0xE7		// 把驱动器写缓存中的数据写到盘上.
+#define WIN_SETFEATURES	0xEF		// 设置驱动器特性(特性码放在HD_PRECOMP中).
+
+/* SET FEATURES sub-commands */
+/* 设置驱动器特性命令的特性码 */
+#define SETFEATURES_WC_ON	0x02	// 打开写缓存.
+#define SETFEATURES_WC_OFF	0x82	// 关闭写缓存.
+
+/* PCI IDE bus-master registers, offsets from BAR4 (primary channel) */
+/* PCI IDE总线主控(bus-master)DMA寄存器,是相对于PCI配置空间BAR4给出的基地址的偏移(主通道) */
+#define BM_COMMAND		0			// 命令寄存器.
+#define BM_STATUS		2			// 状态寄存器.
+#define BM_PRD_ADDR		4			// PRD(物理区域描述符)表的物理地址.
+
+#define BM_CMD_START	0x01		// 启动DMA传输.
+#define BM_CMD_READ		0x08		// 传输方向:1 - 从磁盘读到内存.
+#define BM_STAT_ACTIVE	0x01		// DMA传输正在进行.
+#define BM_STAT_ERR		0x02		// DMA传输出错(写1清除).
+#define BM_STAT_INTR	0x04		// 驱动器已发出中断(写1清除).
+#define PRD_EOT			0x80000000	// PRD表最后一项标志.
+
+/* Bits for HD_CURRENT */
+/* 驱动器/磁头寄存器(HD_CURRENT)中的LBA方式位.置位时扇区,柱面低/高字节寄存器和磁头号依次是28位线性扇区号的0-7,8-15,16-23,24-27位 */
+#define HD_LBA		0x40
 
 /* Bits for HD_ERROR */
 /* 错误寄存器各位的含义(HD_ERROR) */
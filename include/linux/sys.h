@@ -94,6 +94,12 @@ extern int sys_symlink();       // 83 - 建立符号链接。          （fs/nam
 extern int sys_lstat();         // 84 - 取符号链接文件状态。     （fs/stat.c）
 extern int sys_readlink();      // 85 - 读取符号链接文件信息。    （fs/stat.c）
 extern int sys_uselib();        // 86 - 选择共享库。            （fs/exec.c）
+extern int sys_bufstat();       // 87 - 取高速缓冲统计信息。      （fs/buffer.c）
+extern int sys_bdflush();       // 88 - 缓冲回写任务及其参数。    （fs/buffer.c）
+extern int sys_blktrace();      // 89 - 块设备I/O跟踪。           （kernel/blk_drv/blktrace.c）
+extern int sys_fsync();         // 90 - 把文件数据写到设备上。    （fs/buffer.c）
+extern int sys_fdatasync();     // 91 - 只把文件数据写到设备上。  （fs/buffer.c）
+extern int sys_dcachestat();    // 92 - 取目录项缓存统计信息。    （fs/dcache.c）
 
 // 系统调用函数指针表.用于系统调用中断处理程序(int 0x80),作为跳转表.
 fn_ptr sys_call_table[] = { sys_setup, sys_exit, sys_fork, sys_read,
@@ -111,7 +117,8 @@ sys_getpgrp, sys_setsid, sys_sigaction, sys_sgetmask, sys_ssetmask,
 sys_setreuid,sys_setregid, sys_sigsuspend, sys_sigpending, sys_sethostname,
 sys_setrlimit, sys_getrlimit, sys_getrusage, sys_gettimeofday,
 sys_settimeofday, sys_getgroups, sys_setgroups, sys_select, sys_symlink,
-sys_lstat, sys_readlink, sys_uselib };
+sys_lstat, sys_readlink, sys_uselib, sys_bufstat,
+sys_bdflush, sys_blktrace, sys_fsync, sys_fdatasync, sys_dcachestat };
 
 /* So we don't have to do any more manual updating.... */
 /*　下面这样定义后,我们就无需手工更新系统调用数目了　*/
@@ -161,6 +161,12 @@
 #define __NR_lstat	84
 #define __NR_readlink	85
 #define __NR_uselib	86
+#define __NR_bufstat	87
+#define __NR_bdflush	88
+#define __NR_blktrace	89
+#define __NR_fsync	90
+#define __NR_fdatasync	91
+#define __NR_dcachestat	92
 
 // 以下定义系统调用嵌入式汇编宏函数.
 // 不带参数的系统调用宏函数,type_name(void).
@@ -278,6 +284,8 @@ int stat(const char * filename, struct stat * stat_buf);
 int fstat(int fildes, struct stat * stat_buf);
 int stime(time_t * tptr);
 int sync(void);
+int fsync(int fildes);
+int fdatasync(int fildes);
 time_t time(time_t * tloc);
 time_t times(struct tms * tbuf);
 int ulimit(int cmd, long limit);
@@ -58,6 +58,8 @@ _syscall0(int, pause)
 _syscall1(int, setup, void *, BIOS)
 // int sync()系统调用：更新文件系统。
 _syscall0(int, sync)
+// int bdflush(int func, long data)系统调用：缓冲回写任务。
+_syscall2(int, bdflush, int, func, long, data)
 
 #include <linux/tty.h>                  			// tty头文件，定义了有关tty_io，串行通信方面的参数，常数
 #include <linux/sched.h>							// 调度程序头文件,定义了任务结构task_struct,第1个初始任务的数据.还有一些以宏的
@@ -85,12 +87,13 @@ static char printbuf[1024];							// 静态字符串数组,用作内核显示信
 extern char *strcpy();
 extern int vsprintf();								// 送格式化输出到一字符串中(vsprintf.c)
 extern void init(void);								// 函数原型,初始化
-extern void blk_dev_init(void);						// 块设备初始化子程序(blk_drv/ll_rw_blk.c)
+extern void blk_dev_init(int deadline_majors);		// 块设备初始化子程序(blk_drv/ll_rw_blk.c)
 extern void chr_dev_init(void);						// 字符设备初始化(chr_drv/tty_io.c)
 extern void hd_init(void);							// 硬盘初始化程序(blk_drv/hd.c)
 extern void floppy_init(void);						// 软驱初始化程序(blk_drv/floppy.c)
 extern void mem_init(long start, long end);			// 内存管理初始化(mm/memory.c)
 extern long rd_init(long mem_start, int length);	// 虚拟盘初始化(blk_drv/ramdisk.c)
+extern long inode_init(long mem_start, long mem_end);	// i节点表初始化(fs/inode.c)
 extern long kernel_mktime(struct tm * tm);			// 计算系统开机启动时间(秒)
 
 // fork系统调用函数,该函数作为static inline表示内联函数，主要用来在进程0里面创建进程1的时候内联，使进程0在生成进程1的时候
@@ -133,6 +136,7 @@ static int sprintf(char * str, const char *fmt, ...)
 #define DRIVE_INFO (*((struct drive_info *)0x90080))					// 硬盘参数表32字节内容.
 #define ORIG_ROOT_DEV (*(unsigned short *)0x901FC)						// 根文件系统所在设备号.
 #define ORIG_SWAP_DEV (*(unsigned short *)0x901FA)						// 交换文件所在设备号.
+#define ORIG_SCHED_MAJORS (*(unsigned short *)0x901F8)					// 使用deadline调度程序的主设备位图.
 
 /*
  * Yeah, yeah, it's ugly, but I cannot find how to do this correctly
@@ -242,10 +246,12 @@ int main(void)										/* This really IS void, no error here. */
 #ifdef RAMDISK
 	main_memory_start += rd_init(main_memory_start, RAMDISK * 1024);
 #endif
+	// 内存i节点表也放在主内存区开始处,其大小随内存容量而定.
+	main_memory_start += inode_init(main_memory_start, memory_end);
 	// 以下是内核进行所有方面的初始化工作.
 	mem_init(main_memory_start, memory_end);						// 主内存区初始化.(mm/memory.c)
 	trap_init();                                    				// 陷阱门(硬件中断向量)初始化.(kernel/traps.c)
-	blk_dev_init();													// 块设备初始化.(blk_drv/ll_rw_blk.c)
+	blk_dev_init(ORIG_SCHED_MAJORS);									// 块设备初始化.(blk_drv/ll_rw_blk.c)
 	chr_dev_init();													// 字符设备初始化.(chr_drv/tty_io.c)
  	tty_init();														// tty初始化(chr_drv/tty_io.c)
 	time_init();													// 设置开机启动时间.
@@ -313,6 +319,12 @@ void init(void)
 	printf("<<<<< %d buffers = %d bytes buffer space >>>>>\n\r", NR_BUFFERS,
 			NR_BUFFERS * BLOCK_SIZE);
 	printf("<<<<< Free mem: %d bytes >>>>>\n\r", memory_end - main_memory_start);
+	// 创建缓冲回写任务.子进程执行bdflush(0)后即在内核中循环,按时间和已修改块比例把高速缓冲中的已修改块写盘,不再返回.
+	if (!(pid = fork())) {
+		close(0); close(1); close(2);
+		bdflush(0, 0);
+		_exit(3);
+	}
 	// 下面fork()用于创建一个子进程(任务2).对于被创建的子进程,fork()将返回0值,对于原进程(父进程)则返回子进程的进程号pid.所以第202--206行是子进程执行的内容.
 	// 该子进程关闭了句柄0(stdin),以只读方式打开/etc/rc文件,并使用execve()函数将进程自身替换成/bin/sh程序(即shell程序),然后执行/bin/sh程序.所携带的参数
 	// 和环境变量分别由argv_rc和envp_rc数组给出.关闭句柄0并立刻打开/etc/rc文件的作用是把标准输入stdin重定向到/etc/rc/文件.这样shell程序/bin/sh就可以运行
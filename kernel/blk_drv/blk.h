@@ -3,26 +3,40 @@
 
 #include <linux/kernel.h>
 #include <linux/sched.h>
+#include <linux/blktrace.h>
 
 #define NR_BLK_DEV	7	// 块设备类型数量.
 /*
- * NR_REQUEST is the number of entries in the request-queue.
- * NOTE that writes may use only the low 2/3 of these: reads
- * take precedence.
+ * NR_REQUEST is the total number of request-structs. They are split
+ * into per-device pools at boot (see blk_dev_init), so that a burst
+ * on one device can't use up the requests of another. NOTE that writes
+ * may use only 2/3 of a pool: reads take precedence.
  *
- * 32 seems to be a reasonable number: enough to get some benefit
- * from the elevator-mechanism, but not so much as to lock a lot of
- * buffers when they are in the queue. 64 seems to be too many (easily
- * long pauses in reading when heavy writing/syncing is going on)
+ * The pools are 8 requests for the ram disk, 16 for the floppy and 32
+ * for the hard disk (see nr_requests[] in ll_rw_blk.c): enough to get
+ * some benefit from the elevator-mechanism on the slow devices, but not
+ * so much as to lock a lot of buffers when they are in the queue.
+ * NR_REQUEST is their sum: keep the two in step.
  */
 /*
- * 下面定义的NR_REQUEST是请求队列中所包含的项数.
- * 注意,写操作仅使用这些项中低端的2/3项;读操作优先处理.
+ * 下面定义的NR_REQUEST是请求项的总数.系统启动时它们被分配给各个块设备作为各自的请求项池(参见blk_dev_init()),这样一个设备上的大量
+ * 请求不会用光其他设备的请求项.注意,写操作仅能使用请求项池的2/3;读操作优先处理.
  *
- * 32项好像是一个合理的数字:该数已经足够从电梯算法中获得好处,但当缓冲区在队列中而锁住时又不显得是很大的数.64就看上去太大了(
- * 当大量的写/同步操作运行时很容易引起长时间的暂停).
+ * 各请求项池的大小是:虚拟盘8项,软盘16项,硬盘32项(参见ll_rw_blk.c中的nr_requests[]).这些数已经足够在慢速设备上从电梯算法中获得
+ * 好处,但当缓冲区在队列中而锁住时又不显得是很大的数.NR_REQUEST是它们的和,修改时两处要保持一致.
  */
-#define NR_REQUEST	32
+#define NR_REQUEST	56
+
+/*
+ * 屏障请求项的命令(READ/WRITE之外).屏障请求项加在队列末尾,它前面的请求项都完成后才会被处理,处理时驱动程序把驱动器写缓存中的数据写到盘上.
+ * 以后加入的请求项不会被排到它前面,也不会与它前面的请求项合并.
+ */
+#define FLUSH		4
+
+/*
+ * 相邻的读/写请求会被合并成一个请求项,但一个请求项最多包含MAX_SECTORS个扇区(硬盘控制器一次命令最多可读写256个扇区).
+ */
+#define MAX_SECTORS	128
 
 /*
  * Ok, this is an expanded form so that we can use the same
@@ -40,9 +54,15 @@ struct request {
 	int errors;             			// 操作时产生的错误次数.
 	unsigned long sector;   			// 起始扇区.(1块=2扇区)
 	unsigned long nr_sectors;			// 读/写扇区数.
+	unsigned long current_nr_sectors;	// 当前缓冲块中还需读/写的扇区数.
 	char * buffer;                  	// 数据缓冲区.
 	struct task_struct * waiting;   	// 任务等待请求完成操作的地方(队列).
-	struct buffer_head * bh;        	// 缓冲区头指针(include/linux/fs.h).
+	struct buffer_head * bh;        	// 缓冲区头指针(include/linux/fs.h).合并后的请求项含有一串由b_reqnext链接的缓冲块.
+	struct buffer_head * bhtail;    	// 缓冲块链表中的最后一块.
+	unsigned long deadline;				// 期限(滴答数),供deadline调度程序使用.
+	unsigned long start_time;			// 加入队列的时间(滴答数),用于统计延迟.
+	unsigned long issue_sector;			// 发给驱动程序时的起始扇区和扇区数.驱动程序处理过程中会改变sector和nr_sectors,
+	unsigned long issue_nr_sectors;		// 所以完成时按这两项记录(参见blktrace.c).
 	struct request * next;          	// 指向下一请求项.
 };
 
@@ -62,15 +82,41 @@ struct request {
 ((s1)->dev < (s2)->dev || ((s1)->dev == (s2)->dev && \
 (s1)->sector < (s2)->sector)))
 
+struct blk_dev_struct;
+
+// I/O调度程序操作表.
+// 每个块设备的请求队列都是以current_request为头的请求项链表,链表头是驱动程序正在处理的请求项.调度程序决定新请求项在链表中的位置以及
+// 当前请求项完成后接着处理哪一个:
+// merge - 把缓冲块合并到队列中已有的请求项中,成功返回1;
+// insert - 把新请求项插入队列(此时队列不空,且已关中断);
+// dispatch - 当前请求项done完成后,从其后的请求项中选出下一个要处理的请求项,并返回新的队列头(在中断过程中调用).
+struct io_sched {
+	char * name;
+	int (*merge)(struct blk_dev_struct * dev, int rw, struct buffer_head * bh);
+	void (*insert)(struct blk_dev_struct * dev, struct request * req);
+	struct request * (*dispatch)(struct blk_dev_struct * dev, struct request * done);
+};
+
+extern struct io_sched elevator_sched;					// 电梯调度程序(原来的IN_ORDER排序).
+extern struct io_sched deadline_sched;					// 带读写期限的deadline调度程序.
+
 // 块设备处理结构.
 struct blk_dev_struct {
 	void (*request_fn)(void);							// 请求处理函数指针
 	struct request * current_request;					// 当前处理的请求结构.
+	struct io_sched * sched;							// I/O调度程序.
+	struct request * free_request;						// 本设备空闲请求项链表(用next字段链接).
+	int nr_requests;									// 本设备请求项池的大小.
+	int nr_free;										// 空闲请求项数.
+	struct task_struct * wait_for_request;				// 等待本设备空闲请求项的进程队列头指针.
 };
 
 extern struct blk_dev_struct blk_dev[NR_BLK_DEV];       // 块设备表(数组).每种块设备占用一项,共7项.
-extern struct request request[NR_REQUEST];              // 请求队列数组,共32项.
-extern struct task_struct * wait_for_request;           // 等待空闲请求项的进程队列头指针.
+
+// I/O跟踪函数(blk_drv/blktrace.c).
+extern void blk_trace(int action, struct request * req);
+extern void blk_trace_bh(int action, int rw, struct buffer_head * bh);
+extern void blk_trace_poll(int dev, int spins, int defer);
 
 // 设备数据块总数指针数组.每个指针项指向指定主设备号的总块数组hd_sizes[].该总块数数组每一项对应子设备号确定的一个子设备上所拥有的
 // 数据块总数(1块大小=1KB).
@@ -154,25 +200,44 @@ static inline void unlock_buffer(struct buffer_head * bh)
 
 // 结束请求处理.
 // 参数uptodate是更新标志.
-// 首先关闭指定块设备,然后检查此次读写缓冲区是否有效.如果有效则根据参数值设置缓冲区数据更新标志,并解锁该缓冲区.如果更新标志参数值是0,
-// 表示此次请求项的操作失败,因此显示相关块设备IO错误信息.最后,唤醒等待该请求项的进程以及等待空闲请求项出现的进程,释放并从请求链表
-// 中删除本请求项,并把当前请求项指针指向下一请求项.
+// 一个请求项可能含有多个缓冲块,本函数每次只结束当前的一个缓冲块.首先让请求项的起始扇区越过当前缓冲块中剩余的扇区(驱动程序若已经逐个扇区
+// 地调整过sector,则current_nr_sectors此时为0),然后根据参数值设置该缓冲块的数据更新标志并解锁.如果更新标志参数值是0,表示此次操作失败,显示
+// 相关块设备IO错误信息.若请求项中还有缓冲块,则让请求项的缓冲区指针指向下一缓冲块后返回,驱动程序继续处理本请求项.否则关闭设备,唤醒等待该请求项
+// 的进程,由调度程序选出下一请求项作为当前请求项,然后把本请求项放回设备的空闲链表并唤醒等待本设备空闲请求项的进程.
 static inline void end_request(int uptodate)
 {
-	DEVICE_OFF(CURRENT->dev);							// 关闭设备
-	if (CURRENT->bh) {									// CURRENT为当前请求结构项指针
-		CURRENT->bh->b_uptodate = uptodate;				// 置更新标志.
-		unlock_buffer(CURRENT->bh);						// 解锁缓冲区.
-	}
+	struct request * req = CURRENT;
+	struct buffer_head * bh;
+
 	if (!uptodate) {									// 若更新标志为0则显示出错信息.
 		printk(DEVICE_NAME " I/O error\n\r");
-		printk("dev %04x, block %d\n\r",CURRENT->dev,
-			CURRENT->bh->b_blocknr);
+		printk("dev %04x, sector %d\n\r", req->dev, req->sector);
+	}
+	req->sector += req->current_nr_sectors;
+	req->nr_sectors -= req->current_nr_sectors;
+	if (bh = req->bh) {									// CURRENT为当前请求结构项指针
+		req->bh = bh->b_reqnext;
+		bh->b_reqnext = NULL;
+		bh->b_uptodate = uptodate;						// 置更新标志.
+		unlock_buffer(bh);								// 解锁缓冲区.
+		if (bh = req->bh) {								// 请求项中还有缓冲块.
+			req->errors = 0;
+			req->buffer = bh->b_data;
+			req->current_nr_sectors = BLOCK_SIZE >> 9;
+			return;
+		}
 	}
-	wake_up(&CURRENT->waiting);							// 唤醒等待该请求项的进程.
-	wake_up(&wait_for_request);							// 唤醒等待空闲请求项的进程.
-	CURRENT->dev = -1;									// 释放该请求项.
-	CURRENT = CURRENT->next;							// 指向下一请求项.
+	DEVICE_OFF(req->dev);								// 关闭设备
+	wake_up(&req->waiting);								// 唤醒等待该请求项的进程.
+	blk_trace(BLK_TA_COMPLETE, req);
+	CURRENT = blk_dev[MAJOR_NR].sched->dispatch(blk_dev + MAJOR_NR, req);	// 由调度程序选择下一请求项.
+	if (CURRENT)
+		blk_trace(BLK_TA_ISSUE, CURRENT);
+	req->dev = -1;										// 释放该请求项,放回本设备的空闲链表.
+	req->next = blk_dev[MAJOR_NR].free_request;
+	blk_dev[MAJOR_NR].free_request = req;
+	blk_dev[MAJOR_NR].nr_free++;
+	wake_up(&blk_dev[MAJOR_NR].wait_for_request);		// 唤醒等待空闲请求项的进程.
 }
 
 // 如果定义了设备超时符号常量DEVICE_TIMEOUT,则定义CLEAR_DEVICE_TIMEOUT符号常量为"DEVICE_TIMEOUT =0".否则定义CLEAR_DEVICE_TIMEOUT为空.
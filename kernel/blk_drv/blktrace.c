@@ -0,0 +1,158 @@
+/*
+ *  linux/kernel/blk_drv/blktrace.c
+ */
+
+/*
+ * Block I/O tracing. Every queue/merge/insert/issue/complete event is
+ * put in a small ring buffer, which user space reads with blktrace().
+ * Per-major latency and queue-depth histograms are kept at the same
+ * time, so they are there even if nobody reads the events.
+ */
+/*
+ * 块设备I/O跟踪.每次请求的排队/合并/插入/开始处理/完成事件都被记录到一个小的环形缓冲区中,用户程序通过blktrace()系统调用读取.
+ * 同时统计每个主设备的请求延迟和队列深度直方图,即使没有程序读取事件记录,这些统计也始终存在.
+ */
+#include <errno.h>
+#include <linux/sched.h>
+#include <linux/kernel.h>
+#include <linux/blktrace.h>
+#include <asm/system.h>
+#include <asm/segment.h>
+
+#include "blk.h"
+
+static struct blk_trace_event trace_buf[BLKTRACE_SIZE];	// 事件环形缓冲区.
+static unsigned long trace_head = 0;					// 已写入的事件总数.
+static unsigned long trace_tail = 0;					// 已读出的事件总数.
+static struct blk_trace_info trace_info;				// 统计信息.
+
+// 取直方图的槽号:0对应0,n对应[2^(n-1), 2^n),超出范围的都计入最后一槽.
+static inline int hist_slot(unsigned long val)
+{
+	int n = 0;
+
+	while (val && n < BLK_HIST_SLOTS - 1) {
+		val >>= 1;
+		n++;
+	}
+	return n;
+}
+
+// 记录一个事件.既会在进程上下文中也会在中断中调用,所以要关中断并在最后恢复原来的中断状态.
+static void add_event(int action, int dev, int cmd, unsigned long sector, int nr_sectors)
+{
+	struct blk_trace_event * ev;
+	struct blk_dev_struct * bd = blk_dev + MAJOR(dev);
+	unsigned long flags;
+
+	save_flags(flags);
+	cli();
+	ev = trace_buf + (trace_head++ % BLKTRACE_SIZE);
+	if (trace_head - trace_tail > BLKTRACE_SIZE) {		// 缓冲区满,丢弃最早的事件.
+		trace_tail++;
+		trace_info.bt_lost++;
+	}
+	ev->time = jiffies;
+	ev->sector = sector;
+	ev->dev = dev;
+	ev->nr_sectors = nr_sectors;
+	ev->action = action;
+	ev->cmd = cmd;
+	ev->depth = bd->nr_requests - bd->nr_free;
+	restore_flags(flags);
+}
+
+// 记录缓冲块事件(BLK_TA_QUEUE,BLK_TA_MERGE).由make_request()调用.
+void blk_trace_bh(int action, int rw, struct buffer_head * bh)
+{
+	if (action == BLK_TA_MERGE)
+		trace_info.bt_stat[MAJOR(bh->b_dev)].bt_merges++;
+	add_event(action, bh->b_dev, rw, bh->b_blocknr << 1, BLOCK_SIZE >> 9);
+}
+
+// 记录请求项事件(BLK_TA_INSERT,BLK_TA_ISSUE,BLK_TA_COMPLETE),并更新统计信息.插入时统计队列深度,完成时统计延迟.
+// 请求项发出后不再参与合并,而驱动程序会在处理过程中推进sector并递减nr_sectors,因此发出时记下请求项的起始扇区和大小,完成时按它们记录.
+void blk_trace(int action, struct request * req)
+{
+	struct blk_trace_stat * st = trace_info.bt_stat + MAJOR(req->dev);
+	struct blk_dev_struct * bd = blk_dev + MAJOR(req->dev);
+	unsigned long lat;
+
+	if (action == BLK_TA_INSERT)
+		st->bt_depth_hist[hist_slot(bd->nr_requests - bd->nr_free)]++;
+	else if (action == BLK_TA_ISSUE) {
+		req->issue_sector = req->sector;
+		req->issue_nr_sectors = req->nr_sectors;
+	} else if (action == BLK_TA_COMPLETE) {
+		lat = jiffies - req->start_time;
+		st->bt_requests++;
+		st->bt_sectors += req->issue_nr_sectors;
+		st->bt_lat_total += lat;
+		st->bt_lat_hist[hist_slot(lat)]++;
+		add_event(action, req->dev, req->cmd, req->issue_sector, req->issue_nr_sectors);
+		return;
+	}
+	add_event(action, req->dev, req->cmd, req->sector, req->nr_sectors);
+}
+
+// 记录驱动程序轮询设备状态的开销:spins是循环次数,defer表示设备未就绪而推迟了轮询.
+void blk_trace_poll(int dev, int spins, int defer)
+{
+	struct blk_trace_stat * st = trace_info.bt_stat + MAJOR(dev);
+
+	st->bt_poll_spins += spins;
+	if (defer)
+		st->bt_poll_defers++;
+}
+
+// 系统调用blktrace().
+// func = BLKTRACE_READ:把最多count个尚未读过的事件记录复制到用户缓冲区buf中,返回复制的记录数;
+// func = BLKTRACE_STAT:把统计信息(struct blk_trace_info)复制到buf中;
+// func = BLKTRACE_RESET:清除事件缓冲区和统计信息(仅超级用户).
+int sys_blktrace(int func, char * buf, int count)
+{
+	struct blk_trace_event ev;
+	unsigned long flags;
+	int i, n = 0;
+
+	switch (func) {
+		case BLKTRACE_READ:
+			if (!buf || count < 0)
+				return -EINVAL;
+			// 缓冲区中最多只有BLKTRACE_SIZE个事件.先限制count,否则count * sizeof ev可能溢出,使verify_area()只检查了一小块区域.
+			if (count > BLKTRACE_SIZE)
+				count = BLKTRACE_SIZE;
+			verify_area(buf, count * sizeof ev);
+			while (n < count) {
+				save_flags(flags);
+				cli();
+				if (trace_tail == trace_head) {
+					restore_flags(flags);
+					break;
+				}
+				ev = trace_buf[trace_tail++ % BLKTRACE_SIZE];
+				restore_flags(flags);
+				for (i = 0; i < sizeof ev; i++)
+					put_fs_byte(((char *) &ev)[i], buf++);
+				n++;
+			}
+			return n;
+		case BLKTRACE_STAT:
+			if (!buf)
+				return -EINVAL;
+			verify_area(buf, sizeof trace_info);
+			for (i = 0; i < sizeof trace_info; i++)
+				put_fs_byte(((char *) &trace_info)[i], buf + i);
+			return 0;
+		case BLKTRACE_RESET:
+			if (!suser())
+				return -EPERM;
+			cli();
+			trace_head = trace_tail = 0;
+			for (i = 0; i < sizeof trace_info; i++)
+				((char *) &trace_info)[i] = 0;
+			sti();
+			return 0;
+	}
+	return -EINVAL;
+}
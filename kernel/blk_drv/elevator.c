@@ -0,0 +1,144 @@
+/*
+ *  linux/kernel/blk_drv/elevator.c
+ */
+
+/*
+ * I/O schedulers for the block device request queues. The elevator is
+ * the old IN_ORDER sort from ll_rw_blk.c; the deadline scheduler uses
+ * the same sort, but gives every request an expiry time and jumps to
+ * the oldest expired one (reads first), so that a stream of writes
+ * can't starve readers.
+ */
+/*
+ * 块设备请求队列的I/O调度程序.电梯调度程序就是原来ll_rw_blk.c中的IN_ORDER排序;deadline调度程序使用同样的排序,但为每个请求项设置
+ * 一个期限,当有请求项超过期限时就转去先处理期限最早的请求项(读操作优先),使得大量的写操作不会让读操作长时间得不到处理.
+ */
+#include <linux/sched.h>					// 调度程序头文件,定义了任务结构task_struct,jiffies等.
+#include <linux/kernel.h>
+#include <asm/system.h>						// 系统头文件.定义了设置或修改描述符/中断门等的嵌入式汇编宏.
+
+#include "blk.h"							// 块设备头文件.定义请求数据结构,块设备数据结构和宏等信息.
+
+// deadline调度程序中读/写请求项的期限(滴答数).
+#define READ_EXPIRE		(HZ / 2)
+#define WRITE_EXPIRE	(5 * HZ)
+
+// 把缓冲块合并到已有的请求项中.
+// 在指定设备的请求队列中寻找同一设备,同一命令(READ或WRITE)且扇区正好与缓冲块相邻的请求项.若缓冲块紧接在某请求项之后,就把它链接到该请求项
+// 缓冲块链表的尾部(后向合并);若紧接在某请求项之前,就把它放在链表头部(前向合并).合并后的请求项大小不能超过MAX_SECTORS个扇区.当前请求项
+// (队列头)可能正在由驱动程序处理,因此不参与合并.页面请求项(bh = NULL)也不参与合并,屏障请求项之前的请求项也不参与合并.合并成功返回1,否则返回0.
+// 两个调度程序共用该函数.
+static int merge_request(struct blk_dev_struct * dev, int rw, struct buffer_head * bh)
+{
+	struct request * req;
+	unsigned long sector = bh->b_blocknr << 1;
+
+	struct request * tmp;
+
+	cli();
+	if (!(req = dev->current_request)) {
+		sti();
+		return 0;
+	}
+	for (tmp = req->next ; tmp ; tmp = tmp->next)		// 只能与最后一个屏障请求项之后的请求项合并.
+		if (tmp->cmd == FLUSH)
+			req = tmp;
+	while (req = req->next) {
+		if (req->dev != bh->b_dev || req->cmd != rw || !req->bh ||
+		    req->nr_sectors + 2 > MAX_SECTORS)
+			continue;
+		if (req->sector + req->nr_sectors == sector) {
+			req->bhtail->b_reqnext = bh;
+			req->bhtail = bh;
+		} else if (sector + 2 == req->sector) {
+			bh->b_reqnext = req->bh;
+			req->bh = bh;
+			req->buffer = bh->b_data;
+			req->current_nr_sectors = 2;
+			req->sector = sector;
+		} else
+			continue;
+		req->nr_sectors += 2;
+		bh->b_dirt = 0;
+		sti();
+		return 1;
+	}
+	sti();
+	return 0;
+}
+
+// 电梯算法插入请求项.
+// 利用电梯算法搜索最佳插入位置,然后将请求项插入到请求链表中.在搜索过程中,如果判断出欲插入请求项的缓冲块头指针空,即没有缓冲块,那么就需要找一个项,
+// 其已经有可用的缓冲块.因此若当前插入位置(tmp之后)处的空闲项缓冲块头指针不空,就选择这个位置.电梯算法的作用是让磁盘磁头的移动距离最小,从而改善
+// (减少)硬盘访问时间.下面for循环中if语句用于把req所指请求项与请求队列(链表)中已有的请求项作比较,找出req插入该队列的正确位置顺序.
+// 请求项不能越过屏障请求项,因此只在最后一个屏障请求项之后搜索插入位置;屏障请求项本身总是加在队列末尾.调用时队列不空且已关中断.
+static void elevator_insert(struct blk_dev_struct * dev, struct request * req)
+{
+	struct request * tmp = dev->current_request, * p;
+
+	for (p = tmp->next ; p ; p = p->next)
+		if (p->cmd == FLUSH)
+			tmp = p;
+	for ( ; tmp->next ; tmp = tmp->next) {
+		if (req->cmd == FLUSH)
+			continue;
+		if (!req->bh)
+			if (tmp->next->bh)
+				break;
+			else
+				continue;
+		if ((IN_ORDER(tmp, req) ||
+		    !IN_ORDER(tmp, tmp->next)) &&
+		    IN_ORDER(req, tmp->next))
+			break;
+	}
+	req->next = tmp->next;
+	tmp->next = req;
+}
+
+// 电梯算法选择下一请求项:就是链表中的下一项.
+static struct request * elevator_dispatch(struct blk_dev_struct * dev, struct request * done)
+{
+	return done->next;
+}
+
+// deadline算法插入请求项.设置请求项的期限,然后按电梯算法排序插入.
+static void deadline_insert(struct blk_dev_struct * dev, struct request * req)
+{
+	req->deadline = jiffies + (req->cmd == READ ? READ_EXPIRE : WRITE_EXPIRE);
+	elevator_insert(dev, req);
+}
+
+// deadline算法选择下一请求项.
+// 在done之后,第一个屏障请求项之前的请求项中寻找已超过期限的请求项,读请求项优先,同类中取期限最早的.若没有超期的请求项,或者它就是下一项,则与
+// 电梯算法一样返回下一项.否则把这一段链表"旋转"到该请求项处:把它之前的请求项移到这一段的尾部(屏障请求项之前).由于电梯排序的链表是一个循环扫描
+// 的顺序,旋转后其余请求项仍保持原来的扫描顺序.该函数在中断过程中调用.
+static struct request * deadline_dispatch(struct blk_dev_struct * dev, struct request * done)
+{
+	struct request * head = done->next;
+	struct request * req, * prev, * best = NULL, * best_prev = NULL, * tail = NULL;
+
+	for (prev = NULL, req = head ; req && req->cmd != FLUSH ; prev = req, req = req->next) {
+		tail = req;
+		if ((long) (jiffies - req->deadline) < 0)
+			continue;
+		if (!best || (req->cmd == READ && best->cmd != READ) ||
+		    (req->cmd == best->cmd && (long) (req->deadline - best->deadline) < 0)) {
+			best = req;
+			best_prev = prev;
+		}
+	}
+	if (!best || best == head)
+		return head;
+	best_prev->next = tail->next;
+	tail->next = head;
+	return best;
+}
+
+struct io_sched elevator_sched = {
+	"elevator", merge_request, elevator_insert, elevator_dispatch
+};
+
+struct io_sched deadline_sched = {
+	"deadline", merge_request, deadline_insert, deadline_dispatch
+};
@@ -185,6 +185,26 @@ static unsigned char command = 0;							// 读/写命令.
 unsigned char selected = 0;									// 软驱已选定标志.在处理请求项之前要首先选定软驱.
 struct task_struct * wait_on_floppy_select = NULL;			// 等待选定软驱的任务队列.
 
+/*
+ * Track buffer: a read that misses it reads the whole cylinder (both
+ * heads, using the MT bit) and later reads of that cylinder are copied
+ * from memory without touching the drive. Writes update it.
+ */
+/*
+ * 磁道缓冲区:读操作时若所需的块不在缓冲区中,就(利用多磁道MT位)把整个柱面(两个磁头的磁道)都读入缓冲区,以后读该柱面上的块时直接从内存中复制,
+ * 不再访问软驱.写操作会同时更新缓冲区中的数据.
+ */
+// 缓冲区要能被DMA访问:内核位于1MB以下,而按32KB对齐可保证18KB的缓冲区不跨越64KB边界.最多每磁道18扇区,每柱面2个磁头.
+#define MAX_BUFFER_SECTORS	36
+static char track_buffer[MAX_BUFFER_SECTORS * 512] __attribute__ ((aligned (32768)));
+static int buffer_drive = -1;								// 缓冲区中数据所属的驱动器号(-1表示缓冲区无效).
+static int buffer_track = -1;								// 缓冲区中数据所属的柱面号.
+static struct floppy_struct * buffer_floppy = NULL;			// 缓冲区中数据所属的软盘类型.
+static int read_track = 0;									// 当前读操作读整个柱面到缓冲区.
+
+// 缓冲区中当前扇区(head,sector)所在块的位置.
+#define BUFFER_ADDR (track_buffer + ((head * floppy->sect + sector - 1) << 9))
+
 // 取消选定软驱.
 // 如果函数参数指定的软驱nr当前并没有被选定,则显示警告信息.然后复位软驱已选定标志selected,并唤醒等待选择该软驱的任务.数字输出
 // 寄存器(DOR)的低2位用于指定选择的软驱(0-3对应A-D).
@@ -228,6 +248,8 @@ repeat:
 	// 现在软盘控制器已经选定我们指定的软驱nr.于是取数字输入寄存器DIR的值,如果其最高位(位7)置位,则表示软盘已更换,此时即可关闭马达并
 	// 返回1退出.否则关闭马达返回0退出.表示磁盘没有被更换.
 	if (inb(FD_DIR) & 0x80) {
+		if (buffer_drive == nr)						// 软盘已更换,磁道缓冲区作废.
+			buffer_drive = -1;
 		floppy_off(nr);
 		return 1;
 	}
@@ -250,8 +272,13 @@ static void setup_DMA(void)
 
 	// 首先检测请求项的缓冲区所在位置.如果缓冲区处于内存1MB以上的某个地方,则需要将DMA缓冲区设在临时缓冲区域(tmp_floppy_area)处.因为
 	// 8237A芯片只能在1MB地址范围内寻址.如果是写盘命令,则还需要把数据从请求项缓冲区复制到该临时区域.
+	long count = BLOCK_SIZE - 1;					// 传输字节数-1.
+
 	cli();
-	if (addr >= 0x100000) {
+	if (read_track) {								// 读整个柱面到磁道缓冲区.
+		addr = (long) track_buffer;
+		count = floppy->sect * floppy->head * 512 - 1;
+	} else if (addr >= 0x100000) {
 		addr = (long) tmp_floppy_area;
 		if (command == FD_WRITE)
 			copy_buffer(CURRENT->buffer,tmp_floppy_area);
@@ -284,10 +311,10 @@ static void setup_DMA(void)
 	immoutb_p(addr, 0x81);
 	/* low 8 bits of count-1 (1024-1=0x3ff) */	/* 计数器低8位(1024-1 = 0x3ff) */
 	// 向DMA通道2写入基/当前字节计数值(端口5).
-	immoutb_p(0xff, 5);
+	immoutb_p(count, 5);
 	/* high 8 bits of count-1 */	/* 计数器高8位 */
-	// 一次共传输1024字节(两个扇区).
-	immoutb_p(3, 5);
+	// 一次传输1024字节(两个扇区),读整个柱面时传输整个柱面的扇区.
+	immoutb_p(count >> 8, 5);
 	/* activate DMA 2 */	/* 开启DMA通道2的请求 */
 	immoutb_p(0 | 2, 10);
 	sti();
@@ -353,6 +380,7 @@ static void bad_flp_intr(void)
 {
 	// 首先把当前请求项出错次数增1.如果当前请求项出错次数大于最大允许出错次数,则取消选定当前软驱,并结束该请求项(缓冲区内容没有被更新).
 	CURRENT->errors++;
+	buffer_drive = -1;								// 出错时磁道缓冲区中的数据不再可靠.
 	if (CURRENT->errors > MAX_ERRORS) {
 		floppy_deselect(current_drive);
 		end_request(0);
@@ -391,8 +419,18 @@ static void rw_interrupt(void)
 	// 如果当前请求项的缓冲区位于1MB地址以上,则说明此次软盘读操作的内容还放在临时缓冲区内,需要复制到当前请求项的缓冲区中(因为DMA只能在
 	// 1MB地址范围寻址).最后释放当前软驱(取消选定),执行当前请求项结束处理:唤醒等待该请求项的进程,唤醒等待空闲请求项的进程(若有的话),从软驱
 	// 设备请求项链表中删除本请求项.再继续执行其他软盘请求项操作.
-	if (command == FD_READ && (unsigned long)(CURRENT->buffer) >= 0x100000)
+	// 软盘每次只传输请求项中的一个缓冲块.若请求项是合并而成的,end_request()只结束当前缓冲块,do_fd_request()接着处理其中的下一块.
+	// 若读入的是整个柱面,则记下磁道缓冲区中的数据所属的驱动器和柱面,再从中复制出所需的块.写操作成功后,若所写的块在磁道缓冲区中,则同时更新缓冲区.
+	if (read_track) {
+		buffer_drive = current_drive;
+		buffer_track = track;
+		buffer_floppy = floppy;
+		copy_buffer(BUFFER_ADDR, CURRENT->buffer);
+	} else if (command == FD_READ && (unsigned long)(CURRENT->buffer) >= 0x100000)
 		copy_buffer(tmp_floppy_area,CURRENT->buffer);
+	else if (command == FD_WRITE && buffer_drive == current_drive &&
+	    buffer_track == track && buffer_floppy == floppy)
+		copy_buffer(CURRENT->buffer, BUFFER_ADDR);
 	floppy_deselect(current_drive);
 	end_request(1);
 	do_fd_request();
@@ -405,10 +443,18 @@ void setup_rw_floppy(void)
 	setup_DMA();										// 初始化软盘DMA通道.
 	do_floppy = rw_interrupt;							// 置软盘中断调用函数指针.
 	output_byte(command);								// 发送命令字节.
-	output_byte(head<<2 | current_drive);				// 参数:磁头号 + 驱动器号.
-	output_byte(track);									// 参数:磁道号.
-	output_byte(head);									// 参数:磁头号.
-	output_byte(sector);								// 参数:起始扇区号.
+	// 读整个柱面时从0磁头的第1扇区开始,由于命令中置有MT位,读完0磁头的磁道后控制器会接着读1磁头的磁道.
+	if (read_track) {
+		output_byte(current_drive);						// 参数:磁头号0 + 驱动器号.
+		output_byte(track);								// 参数:磁道号.
+		output_byte(0);									// 参数:磁头号.
+		output_byte(1);									// 参数:起始扇区号.
+	} else {
+		output_byte(head<<2 | current_drive);			// 参数:磁头号 + 驱动器号.
+		output_byte(track);								// 参数:磁道号.
+		output_byte(head);								// 参数:磁头号.
+		output_byte(sector);							// 参数:起始扇区号.
+	}
 	output_byte(2);										/* sector size = 512 */	// 参数:(N=2)512字节.
 	output_byte(floppy->sect);							// 参数:每磁道扇区数.
 	output_byte(floppy->gap);							// 参数:扇区间隔长度.
@@ -569,6 +615,7 @@ static void reset_floppy(void)
 	int i;
 
 	reset = 0;										// 复位标志置0.
+	buffer_drive = -1;								// 磁道缓冲区作废.
 	cur_spec1 = -1;									// 使无效.
 	cur_rate = -1;
 	recalibrate = 1;								// 重新校正标志置位.
@@ -623,6 +670,10 @@ void do_fd_request(void)
 	// 号取得请求项指定软驱的参数块.这个参数块将在下面用于设置软盘操作使用的全局变量参数块.请求项设备号中的软盘类型(MINOR(CURRENT->dev)>>2)
 	// 被用作磁盘类型数组floppy_type[]的索引值来取得指定软驱的参数块.
 	INIT_REQUEST;
+	if (CURRENT->cmd == FLUSH) {					// 软驱没有写缓存,屏障请求项直接结束.
+		end_request(1);
+		goto repeat;
+	}
 	floppy = (MINOR(CURRENT->dev) >> 2) + floppy_type;
 	// 下面开始设置全局变量值.如果当前驱动器号current_drive不是请求项中指定的驱动器号,则置标志seek,表示在执行读/写操作之前需要先让驱动
 	// 器执行寻道处理.然后把当前驱动器号设置为请求项中指定的驱动器号.
@@ -653,6 +704,15 @@ void do_fd_request(void)
 		command = FD_WRITE;
 	else
 		panic("do_fd_request: unknown command");
+	// 读操作:若所需的块在磁道缓冲区中,则直接复制,不必启动软驱.否则读入整个柱面;若读整个柱面出过错(柱面上可能有坏扇区),则只读所需的块.
+	if (command == FD_READ && buffer_drive == current_drive &&
+	    buffer_track == track && buffer_floppy == floppy) {
+		copy_buffer(BUFFER_ADDR, CURRENT->buffer);
+		end_request(1);
+		goto repeat;
+	}
+	read_track = (command == FD_READ && !CURRENT->errors &&
+		floppy->sect * floppy->head <= MAX_BUFFER_SECTORS);
 	// 在上面设置好所有全局变量值之后,我们可以开始执行请求项操作了.该操作利用定时器来启动.因为为了能对软驱进行读写操作,需要首先启动驱动器马达
 	// 并达到正常运转速度.而这需要一定的时间.因此这里利用ticks_to_floppy_on()来计算启动延时时间,然后使用该延时设定一个定时器.当时间到时就调用
 	// 函数floppy_on_interrupt().
@@ -46,6 +46,7 @@
 /* 每扇区读/写操作允许的最多出错次数 */
 #define MAX_ERRORS	7							// 读/写一个扇区时允许的最多出错次数.
 #define MAX_HD		2							// 系统支持的最多硬盘数.
+#define MAX_MULT	16							// 多扇区模式每次中断最多传输的扇区数.
 
 // 重新校正处理函数.
 // 复位操作时在硬盘中断处理程序中调用的重新校正函数
@@ -59,6 +60,30 @@ static int recalibrate = 0;
 // 复位标志.当发生读写错误时会设置该标志并调用相关复位函数,以复位硬盘和控制器.
 static int reset = 0;
 
+// 各硬盘的多扇区模式每组扇区数(0表示不支持,使用单扇区读写命令).在每次复位时通过IDENTIFY和SET MULTIPLE MODE命令重新设置.
+static int hd_mult[MAX_HD] = {0, };
+// 当前读/写命令每次中断传输的扇区数(单扇区命令为1).
+static int mult_count = 1;
+// 写命令发出后等待驱动器请求数据(DRQ)的次数,参见write_start().
+static int drq_tries;
+// 复位过程中正在设置的硬盘号.
+static int reset_drive;
+
+// PCI IDE总线主控DMA.bm_base是主通道总线主控寄存器的I/O基地址(0表示没有找到控制器).hd_dma[]标志各硬盘是否使用DMA传输,在复位时根据驱动器
+// 标识信息设置,DMA出错时清除,改用PIO方式(port_read/port_write).hd_dma_failed[]记住哪些硬盘的DMA出过错,以后复位时不再为它们打开DMA.
+// PRD表每项给出一段内存的物理地址和字节数,每个缓冲块占一项.表不能跨越64KB边界,所以按其大小对齐.内核中线性地址就是物理地址.
+static unsigned short bm_base = 0;
+static int hd_dma[MAX_HD] = {0, };
+static int hd_dma_failed[MAX_HD] = {0, };
+// 各硬盘是否使用LBA方式寻址(驱动器标识信息第49字位9).
+static int hd_lba[MAX_HD] = {0, };
+// 各硬盘是否有打开的写缓存.复位时根据驱动器标识信息和HD_WRITE_CACHE配置打开或关闭写缓存.有写缓存的硬盘在处理屏障请求项时要发出FLUSH CACHE命令.
+static int hd_wcache[MAX_HD] = {0, };
+static struct prd {
+	unsigned long addr;
+	unsigned long count;
+} prd_table[MAX_SECTORS / 2] __attribute__ ((aligned (512)));
+
 /*
  *  This struct defines the HD's and their types.
  */
@@ -94,13 +119,13 @@ static struct hd_struct {
 // 硬盘每个分区数据块总数数组.
 static int hd_sizes[5 * MAX_HD] = {0, };
 
-// 读端口嵌入汇编宏.读端口port,共读nr字,保存在buf中.
+// 读端口嵌入汇编宏.读端口port,共读nr个双字(32位),保存在buf中.使用32位的insl比insw少一半I/O指令.
 #define port_read(port, buf, nr) \
-__asm__("cld;rep;insw"::"d" (port), "D" (buf), "c" (nr):)
+__asm__("cld;rep;insl"::"d" (port), "D" (buf), "c" (nr):)
 
-// 写端口嵌入汇编宏.写端口port,共写nr字,从buf中取数据.
+// 写端口嵌入汇编宏.写端口port,共写nr个双字(32位),从buf中取数据.
 #define port_write(port, buf, nr) \
-__asm__("cld;rep;outsw"::"d" (port), "S" (buf), "c" (nr):)
+__asm__("cld;rep;outsl"::"d" (port), "S" (buf), "c" (nr):)
 
 extern void hd_interrupt(void);		// 硬盘中断过程(sys_call.s)
 extern void rd_load(void);			// 虚拟盘创建加载函数(ramdik.c)
@@ -279,9 +304,9 @@ static void hd_out(unsigned int drive, unsigned int nsect, unsigned int sect,
 {
 	register int port;
 
-	// 首先对参数进行有效性检查.如果驱动器号大于1(只能是0,1)或者磁头号大于15,则程序不支持,停机.否则就判断并循环等待驱动器就绪.如果等待一段时间
+	// 首先对参数进行有效性检查.如果驱动器号大于1(只能是0,1)或者磁头号(除去LBA方式位)大于15,则程序不支持,停机.否则就判断并循环等待驱动器就绪.如果等待一段时间
 	// 后仍未就绪则表示硬盘控制器出错,也停机.
-	if (drive > 1 || head > 15)
+	if (drive > 1 || (head & ~HD_LBA) > 15)
 		panic("Trying to write bad sector");
 	if (!controller_ready())
 		panic("HD controller not ready");
@@ -335,33 +360,125 @@ static void reset_controller(void)
 		printk("HD-controller reset failed: %02x\n\r",i);
 }
 
+static void reset_hd(void);
+static void reset_next(void);
+static void identify_intr(void);
+static void setmult_intr(void);
+static void wcache_intr(void);
+
+// 向控制器发送设置驱动器特性命令.特性码放在HD_PRECOMP寄存器中,这与hd_out()不同,所以单独处理.
+static void hd_set_features(unsigned int drive, unsigned int feature, void (*intr_addr)(void))
+{
+	if (!controller_ready())
+		panic("HD controller not ready");
+	SET_INTR(intr_addr);
+	outb_p(hd_info[drive].ctl, HD_CMD);
+	outb_p(feature, HD_PRECOMP);
+	outb_p(0xA0 | (drive << 4), HD_CURRENT);
+	outb(WIN_SETFEATURES, HD_COMMAND);
+}
+
+// 设置写缓存:若驱动器有写缓存,则按配置HD_WRITE_CACHE打开或关闭它,否则接着设置下一个硬盘.
+static void wcache_start(void)
+{
+	if (!hd_wcache[reset_drive]) {
+		reset_next();
+		return;
+	}
+	hd_set_features(reset_drive, HD_WRITE_CACHE ? SETFEATURES_WC_ON : SETFEATURES_WC_OFF,
+		&wcache_intr);
+}
+
+// 设置写缓存命令的中断调用函数.只有成功关闭了写缓存,才不再需要刷新写缓存;命令失败时写缓存可能仍然是打开的.
+static void wcache_intr(void)
+{
+	if (!win_result() && !HD_WRITE_CACHE)
+		hd_wcache[reset_drive] = 0;
+	reset_next();
+}
+
+// 设置下一个硬盘:向控制器发送"建立驱动器参数"命令.所有硬盘都设置完后,再次调用do_hd_request()开始对请求项进行处理.
+static void reset_next(void)
+{
+	int i = ++reset_drive;
+
+	if (i < NR_HD)
+		hd_out(i, hd_info[i].sect, hd_info[i].sect, hd_info[i].head - 1,
+			hd_info[i].cyl, WIN_SPECIFY, &reset_hd);
+	else
+		do_hd_request();								// 执行请求项处理.
+}
+
 // 硬盘复位操作.
-// 首先复位(重新校正)硬盘控制器.然后发送硬盘控制器命令"建立驱动器参数".在本命令引起的硬盘中断处理程序中又会调用本函数.此时该函数会根据执行该命令的结果判断是
-// 否要进行出错处理或是继续执行请求项处理操作.
+// 首先复位(重新校正)硬盘控制器.然后针对每个硬盘发送硬盘控制器命令"建立驱动器参数".在本命令引起的硬盘中断处理程序中又会调用本函数.此时该函数会根据执行该命令的结果判断是
+// 否要进行出错处理或是继续处理.命令执行成功后再取驱动器标识信息并设置多扇区模式(identify_intr(),setmult_intr()),然后处理下一个硬盘.控制器复位会使驱动器
+// 恢复默认的单扇区模式,因此每次复位后都要重新设置.
 static void reset_hd(void)
 {
-	static int i;
-
-	// 如果复位标志reset是置位的,则把复位标志清零后,执行复位硬盘控制在操作.然后针对第i个硬盘向控制器发送"建立驱动器参数"命令.当控制器执行了该命令后,又会发出硬盘
-	// 中断信号.此时本函数会被中断过程调用而再次执行.由于reset已经标志复位,因此会首先去执行246行开始的语句,判断命令执行是否正常.若还是发生错误就会调用bad_rw_intr()
-	// 函数以统计出错次数并根据次数确定是否在设置reset标志如果又设置了reset标志则跳转到repeat重新执行本函数.若复位操作正常,则针对下一个硬盘发送"建立驱动器参数"
-	// 命令,并作上述处理.如果系统中NR_HD个硬盘都已经正常执行了发送的命令,则再次do_hd_request()函数开始对请求项进行处理.
+	// 如果复位标志reset是置位的,则把复位标志清零后,执行复位硬盘控制在操作.然后针对第1个硬盘发送"建立驱动器参数"命令.当控制器执行了该命令后,又会发出硬盘
+	// 中断信号.此时本函数会被中断过程调用而再次执行.由于reset已经标志复位,因此会首先判断命令执行是否正常.若还是发生错误就会调用bad_rw_intr()
+	// 函数以统计出错次数并根据次数确定是否在设置reset标志如果又设置了reset标志则跳转到repeat重新执行本函数.若出错但不需要复位,则接着设置下一个硬盘.
+	// 若命令执行正常,则向该硬盘发送"取驱动器标识"命令.
 repeat:
 	if (reset) {
 		reset = 0;
-		i = -1;											// 初始化当前硬盘号(静态变量).
+		reset_drive = -1;								// 初始化当前硬盘号.
 		reset_controller();
 	} else if (win_result()) {
 		bad_rw_intr();
 		if (reset)
 			goto repeat;
+	} else {
+		hd_mult[reset_drive] = 0;
+		hd_dma[reset_drive] = 0;
+		hd_lba[reset_drive] = 0;
+		hd_wcache[reset_drive] = 0;
+		hd_out(reset_drive, 0, 0, 0, 0, WIN_IDENTIFY, &identify_intr);
+		return;
 	}
-	i++;												// 处理下一个硬盘(第1个是0).
-	if (i < NR_HD) {
-		hd_out(i, hd_info[i].sect, hd_info[i].sect,hd_info[i].head - 1,
-			hd_info[i].cyl, WIN_SPECIFY, &reset_hd);
-	} else
-		do_hd_request();								// 执行请求项处理.
+	reset_next();
+}
+
+// 取驱动器标识命令的中断调用函数.
+// 标识信息第47字的低字节是驱动器多扇区读写每组最多可传输的扇区数.取不超过它和MAX_MULT的2的幂次作为每组扇区数,发送SET MULTIPLE MODE命令.
+// 不支持该命令的老驱动器会返回错误,此时仍使用单扇区读写.
+static void identify_intr(void)
+{
+	static unsigned short id[256];
+	unsigned long lba_sects;
+	int max, mult;
+
+	if (win_result()) {
+		reset_next();
+		return;
+	}
+	port_read(HD_DATA, id, 128);
+	hd_dma[reset_drive] = bm_base && !hd_dma_failed[reset_drive] &&
+		(id[49] & 0x100);								// 第49字位8:支持DMA.
+	// 第49字位9:支持LBA.第60,61字是LBA方式下可寻址的扇区总数,可能大于CHS参数能表示的容量.
+	if (hd_lba[reset_drive] = id[49] & 0x200) {
+		lba_sects = id[60] | ((unsigned long) id[61] << 16);
+		if (lba_sects > hd[reset_drive * 5].nr_sects)
+			hd[reset_drive * 5].nr_sects = lba_sects;
+	}
+	hd_wcache[reset_drive] = id[82] != 0xffff && (id[82] & 0x20);	// 第82字位5:有写缓存.
+	max = id[47] & 0xff;
+	for (mult = 1; mult * 2 <= max && mult * 2 <= MAX_MULT; mult *= 2)
+		/* nothing */ ;
+	if (mult < 2) {
+		wcache_start();
+		return;
+	}
+	hd_mult[reset_drive] = mult;
+	hd_out(reset_drive, mult, 0, 0, 0, WIN_SETMULT, &setmult_intr);
+}
+
+// 设置多扇区模式命令的中断调用函数.若命令失败,则该硬盘使用单扇区读写.然后设置写缓存.
+static void setmult_intr(void)
+{
+	if (win_result())
+		hd_mult[reset_drive] = 0;
+	wcache_start();
 }
 
 // 意外硬盘中断调用函数
@@ -391,6 +508,8 @@ static void bad_rw_intr(void)
 // 后就会执行该函数.
 static void read_intr(void)
 {
+	int i, n;
+
 	// 该函数首先判断此次读命令操作是否出错.若命令结束后控制器还处于忙状态,或者命令执行错误,则处理硬盘操作失败的问题,接着再次请求硬盘作复位处理并执行其他请求项.然后
 	// 返回.每次读操作出错都会对当前请求项作出错次数累计,若出错次数不到最大允许出错次数一半,则会先执行硬盘复位操作,然后再执行本次请求项处理.若出错次数已经大于等于
 	// 最大允许出错次数MAX_ERRORS(7次),则结束本次请求项的处理而去处理队列中下一个请求项.
@@ -399,29 +518,57 @@ static void read_intr(void)
 		do_hd_request();								// 再次请求硬盘作相应(复位)处理.
 		return;
 	}
-	// 如果读命令没有出错,则从数据寄存器端口把1扇区的数据读到请求项的缓冲区中,并且递减请求项所需读取的扇区数值.若递减后不等于0,表示本项请求还有数据没取完,于是再次置中断
-	// 调用C函数指针do_hd为read_intr()并直接返回,等待硬盘在读出另1个扇区数据后发出中断并再次调用本函数.
-	// 注意:281行语句中的256是指内存字,即512字节.
-	// 注意:262行再次置do_hd指针指向read_intr()是因为硬盘中断处理程序每次调用do_hd时都会将该函数指针置空.
-	port_read(HD_DATA, CURRENT->buffer, 256);			// 读数据到请求结构缓冲区.
-	CURRENT->errors = 0;								// 清出错次数
-	CURRENT->buffer += 512;								// 高速缓冲区指针,指向新的空区.
-	CURRENT->sector++;									// 起始扇区号加1.
-	if (--CURRENT->nr_sectors) {						// 如果所需读出的扇区数还没读完,则再置硬盘调用C函数指针为read_intr().
+	// 如果读命令没有出错,则从数据寄存器端口把1扇区的数据读到请求项的缓冲区中,并且递减请求项所需读取的扇区数值.多扇区读命令每次中断可以读出
+	// mult_count个扇区,因此循环读取,直到读完这一组或者请求项的扇区都已读完.若递减后不等于0,表示本项请求还有数据没取完,于是再次置中断
+	// 调用C函数指针do_hd为read_intr()并直接返回,等待硬盘在读出下一组扇区数据后发出中断并再次调用本函数.
+	// 注意:port_read()中的128是指双字,即512字节.
+	// 注意:再次置do_hd指针指向read_intr()是因为硬盘中断处理程序每次调用do_hd时都会将该函数指针置空.
+	n = mult_count;
+	do {
+		port_read(HD_DATA, CURRENT->buffer, 128);		// 读数据到请求结构缓冲区.
+		CURRENT->errors = 0;							// 清出错次数
+		CURRENT->buffer += 512;							// 高速缓冲区指针,指向新的空区.
+		CURRENT->sector++;								// 起始扇区号加1.
+		i = --CURRENT->nr_sectors;
+		// 合并后的请求项含有多个缓冲块.当前缓冲块的扇区都已读入时,就立即调用end_request()结束该缓冲块(置更新标志并解锁),等待它的进程
+		// 不必等到整个请求项完成.end_request()同时会让缓冲区指针指向下一缓冲块.
+		if (!--CURRENT->current_nr_sectors)
+			end_request(1);
+	} while (i && --n);
+	if (i) {											// 如果所需读出的扇区数还没读完,则再置硬盘调用C函数指针为read_intr().
 		SET_INTR(&read_intr);
 		return;
 	}
-	// 执行到此,说明本次请求项的全部扇区数据已经读完,则调用end_request()函数去处理请求项结束事宜.最后再次调用do_hd_request(),去处理其他硬盘请求项.执行其他硬盘
-	// 请求操作.
-	end_request(1);										// 数据已更新标志置位(1).
+	// 执行到此,说明本次请求项的全部扇区数据已经读完,请求项也已在end_request()中结束.最后再次调用do_hd_request(),去处理其他硬盘请求项.
 	do_hd_request();
 }
 
+// 向数据端口写入n个扇区的数据.
+// 写操作要在中断确认数据已写入后才能结束缓冲块,所以这里不能用end_request()移动缓冲区指针,而是自己沿着请求项的缓冲块链表取下一缓冲块.
+static void write_sectors(int n)
+{
+	char * buf = CURRENT->buffer;
+	int left = CURRENT->current_nr_sectors;
+	struct buffer_head * bh = CURRENT->bh;
+
+	while (n--) {
+		port_write(HD_DATA, buf, 128);					// 向数据端口写128个双字.
+		buf += 512;
+		if (!--left && n) {								// 当前缓冲块已写完,转到下一缓冲块.
+			bh = bh->b_reqnext;
+			buf = bh->b_data;
+			left = BLOCK_SIZE >> 9;
+		}
+	}
+}
+
 // 写扇区中断调用函数
 // 该函数将在硬盘写命令结束引发的硬盘中断过程中被调用.函数功能与read_intr()类似.在写命令执行后会产生硬盘中断信号,并执行硬盘中断处理程序,此时在硬盘中断处理程序中
 // 调用的C函数指针do_hd已经指向write_intr(),因此会在一次写扇区操作完成(或出错)后就会执行该函数.
 static void write_intr(void)
 {
+	int i, n;
+
 	// 该函数首先判断此次写命令操作是否出错.若命令结束后控制器还处于忙状态,或者命令执行错误,则处理硬盘操作失败问题,接着再次请求硬盘作复位处理并执行其他请求项.然后返回.
 	// 在bad_rw_intr()函数中,每次操作出错都会对当前请求项作出错次数累计,若出错次数不到最大允许出错次数的一半,则会先执行硬盘复位操作,然后再执行本次请求项处理.若出错
 	// 次数已经大于等于最大允许出错次数MAX_ERRORS(7次),则结束本次请求项的处理而去处理队列中下一个请求项.do_hd_request()中会根据当时具体的标志状态来判别是否需要先执
@@ -431,20 +578,135 @@ static void write_intr(void)
 		do_hd_request();
 		return;
 	}
-	// 此时说明本次写一扇区操作成功,因为将欲写扇区数减1.若其不为0,则说明还有扇区要写,于是把当前请求起始扇区号+1,并调整请求项数据缓冲区指针指向下一块欲写的数据.然后再重置
-	// 硬盘中断处理程序中调用的C函数指针do_hd(指向本函数).接着向控制器数据端口写入512字节数据,然后函数返回去等待控制器把些数据写入硬盘后产生的中断.
-	if (--CURRENT->nr_sectors) {						// 若还有扇区要写,则
+	// 此时说明本次写的一组扇区(单扇区写命令时是1个扇区)已经写入,于是对其中每个扇区把当前请求起始扇区号+1,调整请求项数据缓冲区指针,并将欲写扇区
+	// 数减1.若当前缓冲块的扇区都已写入,则结束该缓冲块(end_request()会让缓冲区指针指向下一缓冲块).若还有扇区要写,则重置硬盘中断处理程序中调用的
+	// C函数指针do_hd(指向本函数),接着向控制器数据端口写入下一组扇区的数据,然后函数返回去等待控制器把些数据写入硬盘后产生的中断.
+	n = mult_count;
+	do {
 		CURRENT->sector++;								// 当前请求起始扇区号+1,
 		CURRENT->buffer += 512;							// 调整请求缓冲区指针,
+		i = --CURRENT->nr_sectors;
+		if (!--CURRENT->current_nr_sectors)
+			end_request(1);
+	} while (i && --n);
+	if (i) {											// 若还有扇区要写,则
 		SET_INTR(&write_intr);							// do_hd置函数指针为write_intr().
-		port_write(HD_DATA, CURRENT->buffer, 256);		// 向数据端口写256字.
+		write_sectors(i < mult_count ? i : mult_count);
 		return;
 	}
-	// 若本次请求项的全部扇区数据已经写完,则调用end_request()函数去处理请求项结束事宜.最后再次调用do_hd_requrest(),去处理其他硬盘请求项.执行其他硬盘请求操作.
-	end_request(1);										// 处理请求结束事宜(已设置更新标志).
+	// 若本次请求项的全部扇区数据已经写完,请求项已在end_request()中结束.最后再次调用do_hd_requrest(),去处理其他硬盘请求项.
 	do_hd_request();									// 执行其他硬盘请求操作.
 }
 
+// 开始写操作:写入第一组扇区的数据.
+// 驱动器收到写命令后不会发出中断,而是在准备好接收数据时置位状态寄存器中的请求服务标志DRQ_STAT.通常这很快,所以先短暂地轮询DRQ_SPIN次.若驱动器
+// 还没有准备好,就不再空转等待,而是用定时器在下一个滴答再来查看,最多DRQ_TRIES次,仍未就绪则按读写错误处理.轮询的开销记录在I/O跟踪统计中.
+// 在定时器中调用时,要先确认该写命令仍在等待数据(其间可能已超时复位).
+#define DRQ_SPIN	100
+#define DRQ_TRIES	10
+
+static void write_start(void)
+{
+	int i, n;
+
+	if (!CURRENT || DEVICE_INTR != &write_intr)
+		return;
+	for (i = 0 ; i < DRQ_SPIN && !(inb_p(HD_STATUS) & DRQ_STAT) ; i++)
+		/* nothing */ ;
+	if (i < DRQ_SPIN) {
+		blk_trace_poll(CURRENT->dev, i, 0);
+		n = CURRENT->nr_sectors;
+		write_sectors(n < mult_count ? n : mult_count);
+		return;
+	}
+	blk_trace_poll(CURRENT->dev, i, 1);
+	if (++drq_tries < DRQ_TRIES) {
+		add_timer(1, &write_start);
+		return;
+	}
+	CLEAR_DEVICE_INTR
+	CLEAR_DEVICE_TIMEOUT
+	bad_rw_intr();
+	do_hd_request();
+}
+
+// 刷新写缓存命令的中断调用函数.命令完成时,屏障请求项之前写入的数据都已在盘上,结束该请求项.
+static void flush_intr(void)
+{
+	if (win_result()) {
+		bad_rw_intr();
+		do_hd_request();
+		return;
+	}
+	end_request(1);
+	do_hd_request();
+}
+
+// 按当前请求项的缓冲块链表建立PRD表.第1项是当前缓冲块中剩下的扇区,以后每个缓冲块一项.页面请求项(bh = NULL)只有一项.
+static void build_prd(void)
+{
+	struct prd * p = prd_table;
+	struct buffer_head * bh = CURRENT->bh;
+
+	p->addr = (unsigned long) CURRENT->buffer;
+	p->count = CURRENT->current_nr_sectors << 9;
+	while (bh && (bh = bh->b_reqnext)) {
+		(++p)->addr = (unsigned long) bh->b_data;
+		p->count = BLOCK_SIZE;
+	}
+	p->count |= PRD_EOT;
+}
+
+// DMA传输结束的中断调用函数.
+// 停止总线主控器并清除其状态.若DMA或命令出错,则以后(包括复位以后)该硬盘改用PIO方式,并按普通读写错误处理(请求项会用PIO方式重试).否则整个请求项都已传输完毕,
+// 逐个结束其中的缓冲块.
+static void dma_intr(void)
+{
+	int i, st;
+
+	st = inb(bm_base + BM_STATUS);
+	outb(0, bm_base + BM_COMMAND);
+	outb(BM_STAT_ERR | BM_STAT_INTR, bm_base + BM_STATUS);
+	if ((st & BM_STAT_ERR) | win_result()) {
+		printk("hd: DMA error, using PIO\n\r");
+		hd_dma[MINOR(CURRENT->dev) / 5] = 0;
+		hd_dma_failed[MINOR(CURRENT->dev) / 5] = 1;
+		bad_rw_intr();
+		do_hd_request();
+		return;
+	}
+	do {
+		i = CURRENT->nr_sectors - CURRENT->current_nr_sectors;
+		end_request(1);
+	} while (i);
+	do_hd_request();
+}
+
+// 在PCI总线上寻找支持总线主控的IDE控制器(类代码0x0101,编程接口位7置位),取得其BAR4中的总线主控寄存器基地址,并允许其作为总线主控.
+// 使用PCI配置机制#1:向0xCF8端口写入配置地址,从0xCFC端口读写配置数据.
+static void hd_dma_init(void)
+{
+	unsigned long addr, class, bar;
+
+	for (addr = 0x80000000; addr < 0x80010000; addr += 0x100) {	// 总线0上的全部设备和功能.
+		outl(addr, 0xCF8);
+		if ((inl(0xCFC) & 0xffff) == 0xffff)					// 无此设备.
+			continue;
+		outl(addr + 0x08, 0xCF8);
+		class = inl(0xCFC);
+		if ((class >> 16) != 0x0101 || !(class & 0x8000))
+			continue;
+		outl(addr + 0x20, 0xCF8);
+		bar = inl(0xCFC);
+		if (!(bar & 1))											// 必须是I/O空间地址.
+			continue;
+		outl(addr + 0x04, 0xCF8);
+		outl(inl(0xCFC) | 0x05, 0xCFC);							// 允许I/O访问和总线主控.
+		bm_base = bar & 0xfffc;
+		return;
+	}
+}
+
 // 硬盘重新校正(复位)中断调用函数.
 // 该函数会在硬盘执行重新校正操作而引发的硬盘中断中被调用.
 // 如果硬盘控制器返回错误信息,则函数首先进行硬盘读写失败处理,然后请求硬盘作相应(复位)处理.在bad_rw_intr()函数中,每次操作出错都会对当前请求项作出错次数累计,若出错次数
@@ -483,7 +745,6 @@ void hd_times_out(void)
 // 中断过程,若还有请求项需要处理,则也会在硬盘中断过程中调用本函数
 void do_hd_request(void)
 {
-	int i, r;
 	unsigned int block, dev;
 	unsigned int sec, head, cyl;
 	unsigned int nsect;
@@ -495,7 +756,7 @@ void do_hd_request(void)
 	INIT_REQUEST;
  	dev = MINOR(CURRENT->dev);
 	block = CURRENT->sector;						// 请求的起始扇区.
-	if (dev >= 5 * NR_HD || block + 2 > hd[dev].nr_sects) {
+	if (dev >= 5 * NR_HD || block + CURRENT->nr_sectors > hd[dev].nr_sects) {
 		end_request(0);
 		goto repeat;								// 该标号在blk.h最后面.
 	}
@@ -506,12 +767,19 @@ void do_hd_request(void)
 	// 中.其中eax中是到指定位置的对应总磁道数(所有磁头面),edx中是当前磁道上的扇区号.348-349行代码初始时eax是计算出的对应总磁道数,edx中置0.divl指令把edx:eax的对应总磁道数除以硬盘
 	// 总磁头数(hd_info[dev].head),在eax中得到的整除值是柱面号(cyl),edx得到的余数就是对应得当前磁头号(head).
 	// 对应总磁道数 * 每磁道扇区数 + 当前磁道上的扇区号 = 绝对扇区号
-	__asm__("divl %4":"=a" (block), "=d" (sec):"0" (block), "1" (0),
-		"r" (hd_info[dev].sect));
-	// 总磁头数 * 柱面号 + 磁头号 = 对应总磁道数
-	__asm__("divl %4":"=a" (cyl), "=d" (head):"0" (block), "1" (0),
-		"r" (hd_info[dev].head));
-	sec++;											// 对计算所得当前磁道扇区号进行调整.
+	// 如果驱动器支持LBA方式,则不用计算,直接把28位扇区号拆开放到扇区,柱面和磁头号参数中,并在磁头号中置LBA方式位.
+	if (hd_lba[dev]) {
+		sec = block & 0xff;
+		cyl = (block >> 8) & 0xffff;
+		head = ((block >> 24) & 0x0f) | HD_LBA;
+	} else {
+		__asm__("divl %4":"=a" (block), "=d" (sec):"0" (block), "1" (0),
+			"r" (hd_info[dev].sect));
+		// 总磁头数 * 柱面号 + 磁头号 = 对应总磁道数
+		__asm__("divl %4":"=a" (cyl), "=d" (head):"0" (block), "1" (0),
+			"r" (hd_info[dev].head));
+		sec++;										// 对计算所得当前磁道扇区号进行调整.
+	}
 	nsect = CURRENT->nr_sectors;					// 预读/写的扇区数.
 	// 此时我们得到了欲读写的硬盘起始扇区block所对应的硬盘上柱面号(cyl),在当前磁道上的扇区号(sec),磁头号(head)以及欲读写的总扇区数(nsect).接着我们可以根据这些信息向硬盘控制器发送I/O
 	// 操作信息了.但在发送之前我们还需要先看看是否有复位控制器状态和重新校正硬盘的标志.通常在复位操作之后都需要重新校正硬盘磁头位置.若这些标志已被置位,则说明前面的硬盘操作可能出现了一些问题
@@ -530,21 +798,47 @@ void do_hd_request(void)
 			WIN_RESTORE, &recal_intr);
 		return;
 	}
-	// 如果以上两个标志都没有置位,那么我们就可以开始向硬盘控制器发送真正的数据读/写操作命令了.如果当前请求是写扇区操作,则发送命令,循环读取状态寄存器信息并判断请求服务标志DRQ_STAT是否
+	// 如果以上两个标志都没有置位,那么我们就可以开始向硬盘控制器发送真正的数据读/写操作命令了.如果当前请求是写扇区操作,则发送命令后由write_start()
+	// 在驱动器置位请求服务标志DRQ_STAT后写入第一组扇区的数据,以后各组数据在write_intr()中写入.
 	// 置位.DRQ_STAT是硬盘状态寄存器的请求服务位表示驱动器已经准备好在主机和数据端口之间传输一个字或一个字节的数据.如果请求服务DRQ置位则退出循环.若等到循环结束也没有置位,则表示发送的
 	// 要求写硬盘命令失败,于是跳转去处理出现在问题或继续执行下一个硬盘请求.否则我们可以向硬盘控制器数据寄存器端口HD_DATA写入1个扇区的数据.
-	if (CURRENT->cmd == WRITE) {
-		hd_out(dev, nsect, sec, head, cyl, WIN_WRITE, &write_intr);
-		for(i = 0 ; i < 10000 && !(r = inb_p(HD_STATUS) & DRQ_STAT) ; i++)
-			/* nothing */ ;
-		if (!r) {
-			bad_rw_intr();
-			goto repeat;							// 该标号在blk.h文件最后面.
+	// 屏障请求项:此时它之前的请求项都已完成.若硬盘有写缓存,则发出FLUSH CACHE命令把缓存中的数据写到盘上,否则直接结束该请求项.
+	if (CURRENT->cmd == FLUSH) {
+		if (!hd_wcache[dev]) {
+			end_request(1);
+			goto repeat;
 		}
-		port_write(HD_DATA, CURRENT->buffer, 256);
+		hd_out(dev, 0, 0, 0, 0, WIN_FLUSH_CACHE, &flush_intr);
+		return;
+	}
+	// 如果该硬盘支持DMA,则建立PRD表,设置总线主控器的传输方向,发出DMA读/写命令后启动总线主控器.整个请求项在一次中断中完成,传输期间CPU可以
+	// 运行其他任务.
+	if (hd_dma[dev]) {
+		build_prd();
+		outb(0, bm_base + BM_COMMAND);
+		outl((unsigned long) prd_table, bm_base + BM_PRD_ADDR);
+		outb(BM_STAT_ERR | BM_STAT_INTR, bm_base + BM_STATUS);
+		if (CURRENT->cmd == WRITE)
+			hd_out(dev, nsect, sec, head, cyl, WIN_WRITEDMA, &dma_intr);
+		else if (CURRENT->cmd == READ)
+			hd_out(dev, nsect, sec, head, cyl, WIN_READDMA, &dma_intr);
+		else
+			panic("unknown hd-command");
+		outb(CURRENT->cmd == READ ? BM_CMD_START | BM_CMD_READ : BM_CMD_START,
+			bm_base + BM_COMMAND);
+		return;
+	}
+	// 如果该硬盘已设置了多扇区模式,则使用多扇区读/写命令,每次中断传输mult_count个扇区.
+	mult_count = hd_mult[dev] ? hd_mult[dev] : 1;
+	if (CURRENT->cmd == WRITE) {
+		hd_out(dev, nsect, sec, head, cyl,
+			hd_mult[dev] ? WIN_MULTWRITE : WIN_WRITE, &write_intr);
+		drq_tries = 0;
+		write_start();
 	// 如果当前请求是读硬盘数据,则向硬盘控制器发送读扇区命令.若命令无效则停机.
 	} else if (CURRENT->cmd == READ) {
-		hd_out(dev, nsect, sec, head, cyl, WIN_READ, &read_intr);
+		hd_out(dev, nsect, sec, head, cyl,
+			hd_mult[dev] ? WIN_MULTREAD : WIN_READ, &read_intr);
 	} else
 		panic("unknown hd-command");
 }
@@ -557,6 +851,8 @@ void do_hd_request(void)
 void hd_init(void)
 {
 	blk_dev[MAJOR_NR].request_fn = DEVICE_REQUEST;				// do_hd_request().
+	hd_dma_init();												// 寻找PCI IDE总线主控器.
+	reset = 1;													// 第一次读写前先复位,以设置各硬盘的多扇区模式和DMA.
 	set_intr_gate(0x2E, &hd_interrupt);							// 设置中断门中处理函数指针
 	outb_p(inb_p(0x21) & 0xfb, 0x21);							// 复位接联的主8259A int 2的屏蔽位
 	outb(inb_p(0xA1) & 0xbf, 0xA1);								// 复位硬盘中断请求屏蔽位(在从片上).
@@ -0,0 +1,334 @@
+/*
+ *  linux/kernel/blk_drv/inflate.c
+ *
+ * This is an altered version of puff.c from the zlib distribution,
+ * by Mark Adler. The original copyright notice follows.
+ */
+
+/*
+  Copyright (C) 2002-2013 Mark Adler, all rights reserved
+  version 2.3, 21 Jan 2013
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the author be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  Mark Adler    madler@alumni.caltech.edu
+ */
+
+/*
+ * Changes from puff.c: input comes from a get-byte function instead of
+ * a memory buffer, the output buffer is required, and all state and
+ * tables are static.
+ */
+/*
+ * 与puff.c的不同之处:输入数据由取字节函数提供而不是内存缓冲区,必须给出输出缓冲区,所有的状态和表都是静态的.
+ */
+
+/*
+ * A small inflater (RFC 1951) for compressed ram disk images. It is
+ * meant for one thing only: decompressing an image straight into the
+ * ram disk. The whole output is kept in memory, so the output buffer
+ * is the sliding window too, and no separate 32kB window is needed.
+ *
+ * Input comes one byte at a time from a caller-supplied function, so
+ * the image can be streamed in from the boot floppy. All tables are
+ * static - we are running on a 4kB kernel stack.
+ */
+/*
+ * 一个用于压缩内存虚拟盘映像的小型解压程序(RFC 1951 deflate格式).它只用于把映像直接解压到虚拟盘中.由于全部输出都保存在内存中,
+ * 因此输出缓冲区本身就是滑动窗口,不需要另外的32KB窗口.
+ * 输入数据由调用者提供的函数逐字节取得,因此映像可以边从引导软盘读入边解压.由于内核栈只有4KB,所有的表都是静态的.
+ */
+#include <linux/kernel.h>
+
+#define MAXBITS		15				// 哈夫曼码最大长度.
+#define MAXLCODES	286				// 最大文字/长度码数.
+#define MAXDCODES	30				// 最大距离码数.
+#define MAXCODES	(MAXLCODES + MAXDCODES)
+#define FIXLCODES	288				// 固定哈夫曼编码的文字/长度码数.
+
+struct huffman {
+	short * count;					// 每种码长的符号个数.
+	short * symbol;					// 按码字顺序排列的符号.
+};
+
+static int (*get_byte)(void);		// 输入字节函数,出错返回-1.
+static int in_error;				// 输入出错标志.
+static unsigned long bitbuf;		// 位缓冲.
+static int bitcnt;					// 位缓冲中的位数.
+
+static unsigned char * out;			// 输出缓冲区(同时也是窗口).
+static unsigned long outlen;		// 输出缓冲区长度.
+static unsigned long outcnt;		// 已输出字节数.
+
+static short lencnt[MAXBITS + 1], lensym[FIXLCODES];
+static short distcnt[MAXBITS + 1], distsym[MAXDCODES];
+static struct huffman lencode = {lencnt, lensym};
+static struct huffman distcode = {distcnt, distsym};
+static short lengths[MAXCODES];
+
+// 从输入中取need位(低位在前).输入出错时返回0并置in_error,调用者在循环处检查该标志.
+static int bits(int need)
+{
+	long val = bitbuf;
+	int c;
+
+	while (bitcnt < need) {
+		if ((c = get_byte()) < 0) {
+			in_error = 1;
+			c = 0;
+		}
+		val |= (long) c << bitcnt;
+		bitcnt += 8;
+	}
+	bitbuf = val >> need;
+	bitcnt -= need;
+	return (int) (val & ((1L << need) - 1));
+}
+
+// 处理存储(不压缩)块.先丢弃当前字节中剩余的位,然后读取长度LEN及其反码NLEN,最后原样复制LEN个字节.
+static int stored(void)
+{
+	unsigned int len;
+	int c;
+
+	bitbuf = 0;
+	bitcnt = 0;
+	len = bits(16);
+	if ((bits(16) ^ 0xffff) != len)
+		return -3;
+	if (outcnt + len > outlen)
+		return -1;
+	while (len--) {
+		if ((c = get_byte()) < 0)
+			return -2;
+		out[outcnt++] = c;
+	}
+	return 0;
+}
+
+// 用一位一位比较的方式解码一个符号.规范哈夫曼码中同一长度的码字是连续的,所以只需记住每个长度的第一个码字和其符号索引.
+static int decode(struct huffman * h)
+{
+	int len, code = 0, first = 0, index = 0, count;
+
+	for (len = 1; len <= MAXBITS; len++) {
+		code |= bits(1);
+		count = h->count[len];
+		if (code - count < first)
+			return h->symbol[index + (code - first)];
+		index += count;
+		first += count;
+		first <<= 1;
+		code <<= 1;
+	}
+	return -10;						// 码长超过15位,数据错.
+}
+
+// 由码长数组构造规范哈夫曼解码表.返回0表示码是完整的,>0表示不完整,<0表示码长超额(错误).
+static int construct(struct huffman * h, short * length, int n)
+{
+	int symbol, len, left;
+	short offs[MAXBITS + 1];
+
+	for (len = 0; len <= MAXBITS; len++)
+		h->count[len] = 0;
+	for (symbol = 0; symbol < n; symbol++)
+		h->count[length[symbol]]++;
+	if (h->count[0] == n)
+		return 0;
+	left = 1;
+	for (len = 1; len <= MAXBITS; len++) {
+		left <<= 1;
+		left -= h->count[len];
+		if (left < 0)
+			return left;
+	}
+	offs[1] = 0;
+	for (len = 1; len < MAXBITS; len++)
+		offs[len + 1] = offs[len] + h->count[len];
+	for (symbol = 0; symbol < n; symbol++)
+		if (length[symbol])
+			h->symbol[offs[length[symbol]]++] = symbol;
+	return left;
+}
+
+static const short lbase[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const short lext[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const short dbase[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577};
+static const short dext[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11,
+	12, 12, 13, 13};
+
+// 用给定的文字/长度和距离哈夫曼表解码一个压缩块,直到遇到块结束符256.
+static int codes(void)
+{
+	int symbol, len;
+	unsigned long dist;
+
+	do {
+		symbol = decode(&lencode);
+		if (in_error)
+			return -2;
+		if (symbol < 0)
+			return symbol;
+		if (symbol < 256) {							// 文字字节.
+			if (outcnt == outlen)
+				return -1;
+			out[outcnt++] = symbol;
+		} else if (symbol > 256) {					// 长度/距离对,复制前面已输出的数据.
+			symbol -= 257;
+			if (symbol >= 29)
+				return -10;
+			len = lbase[symbol] + bits(lext[symbol]);
+			symbol = decode(&distcode);
+			if (symbol < 0)
+				return symbol;
+			dist = dbase[symbol] + bits(dext[symbol]);
+			if (dist > outcnt)
+				return -11;
+			if (outcnt + len > outlen)
+				return -1;
+			while (len--) {
+				out[outcnt] = out[outcnt - dist];
+				outcnt++;
+			}
+		}
+	} while (symbol != 256);
+	return 0;
+}
+
+// 固定哈夫曼编码块.
+static int fixed(void)
+{
+	int symbol;
+
+	for (symbol = 0; symbol < 144; symbol++)
+		lengths[symbol] = 8;
+	for (; symbol < 256; symbol++)
+		lengths[symbol] = 9;
+	for (; symbol < 280; symbol++)
+		lengths[symbol] = 7;
+	for (; symbol < FIXLCODES; symbol++)
+		lengths[symbol] = 8;
+	construct(&lencode, lengths, FIXLCODES);
+	for (symbol = 0; symbol < MAXDCODES; symbol++)
+		lengths[symbol] = 5;
+	construct(&distcode, lengths, MAXDCODES);
+	return codes();
+}
+
+// 动态哈夫曼编码块.先读入码长码的码长,再用它解码文字/长度码和距离码的码长,最后构造两张解码表.
+static int dynamic(void)
+{
+	int nlen, ndist, ncode, index, err;
+	int symbol, len;
+	static const short order[19] =
+		{16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+	nlen = bits(5) + 257;
+	ndist = bits(5) + 1;
+	ncode = bits(4) + 4;
+	if (nlen > MAXLCODES || ndist > MAXDCODES)
+		return -3;
+	for (index = 0; index < ncode; index++)
+		lengths[order[index]] = bits(3);
+	for (; index < 19; index++)
+		lengths[order[index]] = 0;
+	if (construct(&lencode, lengths, 19) != 0)
+		return -4;
+	index = 0;
+	while (index < nlen + ndist) {
+		symbol = decode(&lencode);
+		if (in_error)
+			return -2;
+		if (symbol < 0)
+			return symbol;
+		if (symbol < 16)
+			lengths[index++] = symbol;
+		else {
+			len = 0;
+			if (symbol == 16) {
+				if (index == 0)
+					return -5;
+				len = lengths[index - 1];
+				symbol = 3 + bits(2);
+			} else if (symbol == 17)
+				symbol = 3 + bits(3);
+			else
+				symbol = 11 + bits(7);
+			if (index + symbol > nlen + ndist)
+				return -6;
+			while (symbol--)
+				lengths[index++] = len;
+		}
+	}
+	if (lengths[256] == 0)
+		return -7;
+	err = construct(&lencode, lengths, nlen);
+	if (err < 0 || (err > 0 && nlen - lencode.count[0] != 1))
+		return -8;
+	err = construct(&distcode, lengths + nlen, ndist);
+	if (err < 0 || (err > 0 && ndist - distcode.count[0] != 1))
+		return -9;
+	return codes();
+}
+
+/*
+ * Inflate a raw deflate stream into dest. Returns the number of bytes
+ * produced, -1 if the output doesn't fit in len bytes, -2 on an input
+ * error and another negative number if the data is corrupt.
+ */
+/*
+ * 把原始deflate数据流解压到dest处.返回解压得到的字节数;若输出超过len字节则返回-1,输入出错返回-2,数据损坏时返回其他负数.
+ */
+long inflate(char * dest, unsigned long len, int (*get)(void))
+{
+	int last, type, err;
+
+	get_byte = get;
+	in_error = 0;
+	bitbuf = 0;
+	bitcnt = 0;
+	out = (unsigned char *) dest;
+	outlen = len;
+	outcnt = 0;
+	do {
+		last = bits(1);
+		type = bits(2);
+		if (type == 0)
+			err = stored();
+		else if (type == 1)
+			err = fixed();
+		else if (type == 2)
+			err = dynamic();
+		else
+			err = -3;
+		if (in_error)
+			err = -2;
+		if (err)
+			return err;
+	} while (!last);
+	return outcnt;
+}
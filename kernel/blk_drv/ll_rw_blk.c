@@ -8,6 +8,7 @@
  * This handles all read/write requests to block devices
  */
 #include <errno.h>
+#include <linux/config.h>
 #include <linux/sched.h>					// 调试程序头文件,定义了任务结构task_struct,任务0数据等.
 #include <linux/kernel.h>
 #include <asm/system.h>						// 系统头文件.定义了设置或修改描述符/中断门等的嵌入式汇编宏.
@@ -21,16 +22,19 @@
 /*
  * 请求结构中含有加载nr个扇区数据到内存中去的所有必须的信息.
  */
-// 请求项数组队列.共有NR_REQUEST = 32个请求项.
-struct request request[NR_REQUEST];
+// 请求项数组.共有NR_REQUEST = 56个请求项,启动时按nr_requests[]分给各个块设备.
+static struct request request[NR_REQUEST];
 
-/*
- * used to wait on when there are no free requests
- */
-/*
- * 是用于在请求数组没有空闲项时进程的临时等待处.
- */
-struct task_struct * wait_for_request = NULL;
+// 各主设备请求项池的大小.没有驱动程序的设备不分配请求项.
+static int nr_requests[NR_BLK_DEV] = {
+	0,		/* no_dev */
+	8,		/* dev mem */
+	16,		/* dev fd */
+	32,		/* dev hd */
+	0,		/* dev ttyx */
+	0,		/* dev tty */
+	0		/* dev lp */
+};
 
 /* blk_dev_struct is:
  *	do_request-address
@@ -43,14 +47,15 @@ struct task_struct * wait_for_request = NULL;
  */
 // 块设备数组.该数组使用主设备号作为索引.实际内容将在各块设备驱动程序初始化时填入.
 // 例如,硬盘驱动程序初始化时(hd.c),第一条语句即用于设备blk_dev[3]的内容.
+// 各设备使用的I/O调度程序和请求项池在blk_dev_init()中设置.
 struct blk_dev_struct blk_dev[NR_BLK_DEV] = {
-	{ NULL, NULL },		/* no_dev */		// 0 - 无设备
-	{ NULL, NULL },		/* dev mem */		// 1 - 内存
-	{ NULL, NULL },		/* dev fd */		// 2 - 软驱设备
-	{ NULL, NULL },		/* dev hd */		// 3 - 硬盘设备
-	{ NULL, NULL },		/* dev ttyx */		// 4 - ttyx设备
-	{ NULL, NULL },		/* dev tty */		// 5 - tty设备
-	{ NULL, NULL }		/* dev lp */		// 6 - lp打印机设备
+	{ NULL, NULL, NULL },		/* no_dev */		// 0 - 无设备
+	{ NULL, NULL, NULL },		/* dev mem */		// 1 - 内存
+	{ NULL, NULL, NULL },		/* dev fd */		// 2 - 软驱设备
+	{ NULL, NULL, NULL },		/* dev hd */		// 3 - 硬盘设备
+	{ NULL, NULL, NULL },		/* dev ttyx */		// 4 - ttyx设备
+	{ NULL, NULL, NULL },		/* dev tty */		// 5 - tty设备
+	{ NULL, NULL, NULL }		/* dev lp */		// 6 - lp打印机设备
 };
 
 /*
@@ -111,38 +116,48 @@ static inline void unlock_buffer(struct buffer_head * bh)
 static void add_request(struct blk_dev_struct * dev, struct request * req)
 {
 	// 首先对参数提供的请求项的指针和标志作初始设置.置空请求项中的下一请求项指针,关中断并清除请求项相关缓冲区脏标志.
-	struct request * tmp;
-
 	req->next = NULL;
+	req->start_time = jiffies;
 	cli();								// 关中断
 	if (req->bh)
 		req->bh->b_dirt = 0;			// 清缓冲区"脏"标志.
 	// 然后查看指定设备是否有当前请求项,即查看设备是否正忙.如果指定设备dev当前请求项(current_equest)字段为空,则表示目前该设备没有请求项,本次是
 	// 第1个请求项,也是唯一的一个.因此可将块设备当前请求指针直接指向该请求项,并立刻执行相应设备的请求函数.
-	if (!(tmp = dev->current_request)) {
+	blk_trace(BLK_TA_INSERT, req);
+	if (!dev->current_request) {
 		dev->current_request = req;
+		blk_trace(BLK_TA_ISSUE, req);
 		sti();							// 开中断.
 		(dev->request_fn)();			// 执行请求函数,对于硬盘是do_hd_request().
 		return;
 	}
-	// 如果目前该设备已经有当前请求项在处理,则首先利用电梯算法搜索最佳插入位置,然后将当前请求项插入到请求链表中.在搜索过程中,如果判断出欲插入
-	// 请求项的缓冲块头指针空,即没有缓冲块,那么就需要找一个项,其已经有可用的缓冲块.因此若当前插入位置(tmp之后)处的空闲项缓冲块头指针不空,就选择这个位置
-	// 于是退出循环并把请求项插入此处.最后开中断并退出函数.电梯算法的作用是让磁盘磁头的移动距离最小,从而改善(减少)硬盘访问时间.
-	// 下面for循环中if语句用于把req所指请求项与请求队列(链表)中已有的请求项作比较,找出req插入该队列的正确位置顺序.然后中断循环,并把req插入到该队列正确位置处.
-	for ( ; tmp->next ; tmp = tmp->next) {
-		if (!req->bh)
-			if (tmp->next->bh)
-				break;
-			else
-				continue;
-		if ((IN_ORDER(tmp, req) ||
-		    !IN_ORDER(tmp, tmp->next)) &&
-		    IN_ORDER(req, tmp->next))
+	// 如果目前该设备已经有当前请求项在处理,则由该设备的I/O调度程序把请求项插入到请求链表中的合适位置.最后开中断并退出函数.
+	(dev->sched->insert)(dev, req);
+	sti();
+}
+
+// 从设备的空闲链表中取一个请求项.
+// 写操作只能使用请求项池的2/3,剩下的留给读操作.若没有可用的请求项,则对于提前读/写(rw_ahead)返回NULL,否则睡眠在本设备的等待队列上,
+// 直到有请求项被释放.由于end_request()在中断中释放请求项,所以这里要关中断.
+static struct request * get_request(struct blk_dev_struct * dev, int rw, int rw_ahead)
+{
+	struct request * req;
+
+	cli();
+	for (;;) {
+		if ((req = dev->free_request) &&
+		    (rw == READ || dev->nr_free * 3 > dev->nr_requests))
 			break;
+		if (rw_ahead) {
+			sti();
+			return NULL;
+		}
+		sleep_on(&dev->wait_for_request);
 	}
-	req->next = tmp->next;
-	tmp->next = req;
+	dev->free_request = req->next;
+	dev->nr_free--;
 	sti();
+	return req;
 }
 
 // 创建请求项并插入请求队列中.
@@ -175,36 +190,24 @@ static void make_request(int major, int rw, struct buffer_head * bh)
 		unlock_buffer(bh);
 		return;
 	}
-repeat:
+	// 先试着把本缓冲块合并到队列中已有的请求项中.
+	blk_trace_bh(BLK_TA_QUEUE, rw, bh);
+	if ((blk_dev[major].sched->merge)(major + blk_dev, rw, bh)) {
+		blk_trace_bh(BLK_TA_MERGE, rw, bh);
+		return;
+	}
 	/* we don't allow the write-requests to fill up the queue completely:
 	 * we want some room for reads: they take precedence. The last third
 	 * of the requests are only for reads.
 	 */
 	/*
-	 * 我们不能让队列中全都是写请求项:我们需要为读请求保留一些空间:读操作是优先的.请求队列的后三分之一空间仅用于读请求项.
+	 * 我们不能让队列中全都是写请求项:我们需要为读请求保留一些空间:读操作是优先的.请求项池的三分之一空间仅用于读请求项.
 	 */
-	// 好,现在我们必须为本函数生成并添加读/写请求项了.首先我们需要在请求数组中寻找到一个空闲项(糟)来存放新请求项.搜索过程从请求数组末端开始.
-	// 根据上述要求,对于读命令请求,我们直接从队列末尾开始搜索,而对于写请求就只能从队列2/3处向队列头处搜索空项填入.于是我们开始从后向前搜索,
-	// 当请求结构request的设备字段dev值=-1时,表示该项未被占用(空闲).如果没有一项是空闲的(此时请求项数组指针已经搜索越过头部),则查看此次请求
-	// 是否是提前读/写(READA或WRITEA),如果是则放弃此次请求操作.否则让本次请求操作先睡眠(以等待请求队列腾出空项),过一会儿再来搜索请求队列.
-	if (rw == READ)
-		req = request + NR_REQUEST;						// 对于读请求,将指针指向队列尾部.
-	else
-		req = request + ((NR_REQUEST * 2) / 3);			// 对于写请求,指针指向队列2/3处.
-	/* find an empty request */
-	/* 搜索一个空请求项 */
-	while (--req >= request)
-		if (req->dev < 0)
-			break;
-	/* if none found, sleep on new requests: check for rw_ahead */
-	/* 如果没有找到空闲项,则让该次请求操作睡眠:需检查是否提前读/写 */
-	if (req < request) {								// 如果已搜索到头(队列无空项)
-		if (rw_ahead) {									// 则若是提前读/写请求,则退出.
-			unlock_buffer(bh);
-			return;
-		}
-		sleep_on(&wait_for_request);					// 否则就睡眠,过会再查看请求队列.
-		goto repeat;
+	// 好,现在我们必须为本函数生成并添加读/写请求项了.首先从本设备的请求项池中取一个空闲项来存放新请求项.如果没有空闲项,则查看此次请求是否是
+	// 提前读/写(READA或WRITEA),如果是则放弃此次请求操作.否则get_request()会让本次请求操作先睡眠(以等待请求项池腾出空项).
+	if (!(req = get_request(major + blk_dev, rw, rw_ahead))) {
+		unlock_buffer(bh);
+		return;
 	}
 	/* fill up the request-info, and add it to the queue */
 	/* 向空闲请求项中填写请求信息,并将其加入队列中 */
@@ -215,9 +218,11 @@ repeat:
 	req->errors = 0;									// 操作时产生的错误次数.
 	req->sector = bh->b_blocknr << 1;					// 起始扇区.块号转换成扇区号(1块=2扇区).
 	req->nr_sectors = 2;								// 本请求项需要读写的扇区数.
+	req->current_nr_sectors = 2;						// 当前缓冲块的扇区数.
 	req->buffer = bh->b_data;							// 请求项缓冲区指针指向需读写的数据缓冲区.
 	req->waiting = NULL;								// 任务等待操作执行完成的地方.
 	req->bh = bh;										// 缓冲块头指针.
+	req->bhtail = bh;									// 缓冲块链表尾.
 	req->next = NULL;									// 指向下一请求项.
 	add_request(major + blk_dev, req);					// 将请求项加入队列中(blk_dev[major],reg).
 }
@@ -237,18 +242,8 @@ void ll_rw_page(int rw, int dev, int page, char * buffer)
 	}
 	if (rw != READ && rw != WRITE)
 		panic("Bad block dev command, must be R/W");
-	// 在参数检测操作完成后,我们现在需要为本次操作建立请求项.首先我们需要在请求数组中寻找到一个空闲项(糟)来存放新请求项.搜索过程从请求数组末端
-	// 开始.于是我们开始从后向前搜索,当请求结构request的设备字段值<0时,表示该项未被占用(空闲).如果没有一项是空闲的(此时请求项数组指针已经搜索越过
-	// 头部),则让本次请求操作先睡眠(以等待请求队列腾出空项),过一会再来搜索请求队列.
-repeat:
-	req = request + NR_REQUEST;							// 将指针指向队列尾部.
-	while (--req >= request)
-		if (req->dev < 0)
-			break;
-	if (req < request) {
-		sleep_on(&wait_for_request);					// 睡眠,过会再查看请求队列.
-		goto repeat;
-	}
+	// 在参数检测操作完成后,我们现在需要为本次操作建立请求项.从本设备的请求项池中取一个空闲项(页面读写可使用整个池),如果没有则睡眠等待.
+	req = get_request(major + blk_dev, READ, 0);
 	/* fill up the request-info, and add it to the queue */
 	/* 向空闲请求项中填写请求信息,并将其加入队列中 */
 	// OK,程序执行到这里表示已找到一个空闲请求项.于是我们设置好新请求项,把当前进程置为不可中断睡眠中断后,就去调用add_request()把它添加到请求队列中,
@@ -260,9 +255,11 @@ repeat:
 	req->errors = 0;									// 读写操作错误计数
 	req->sector = page << 3;							// 起始读写扇区
 	req->nr_sectors = 8;								// 读写扇区数
+	req->current_nr_sectors = 8;						// 整个页面作为一次传输.
 	req->buffer = buffer;								// 数据缓冲区
 	req->waiting = current;								// 当前进程进入该请求等待队列
 	req->bh = NULL;										// 无缓冲块头指针(不用高速缓冲)
+	req->bhtail = NULL;
 	req->next = NULL;									// 下一个请求项指针
 	current->state = TASK_UNINTERRUPTIBLE;				// 置为不可中断状态
 	add_request(major + blk_dev, req);					// 将请求项加入队列中.
@@ -270,6 +267,33 @@ repeat:
 	schedule();
 }
 
+// 刷新设备(屏障).
+// 向设备请求队列的末尾加入一个屏障请求项,并睡眠等待它完成.屏障请求项在它之前的所有请求项都完成后才被处理,驱动程序处理时把驱动器写缓存中的数据写到
+// 盘上(没有写缓存的设备直接结束该请求项).因此本函数返回时,之前已提交的写操作都已确实写到设备上.
+void ll_rw_flush(int dev)
+{
+	struct request * req;
+	unsigned int major = MAJOR(dev);
+
+	if (major >= NR_BLK_DEV || !(blk_dev[major].request_fn))
+		return;
+	req = get_request(major + blk_dev, READ, 0);
+	req->dev = dev;
+	req->cmd = FLUSH;
+	req->errors = 0;
+	req->sector = 0;
+	req->nr_sectors = 0;
+	req->current_nr_sectors = 0;
+	req->buffer = NULL;
+	req->waiting = current;
+	req->bh = NULL;
+	req->bhtail = NULL;
+	req->next = NULL;
+	current->state = TASK_UNINTERRUPTIBLE;
+	add_request(major + blk_dev, req);
+	schedule();
+}
+
 // 低级数据块读写函数(Low Level Read Write Block)
 // 该函数是块设备驱动程序与系统其他部分的接口函数.通常在fs/buffer.c程序中被调用.
 // 主要功能是创建块设备读写请求项并插入到指定块设备请求队列.实际的读写操作则是由设备的request_fn()函数完成.对于硬盘操作,该函数是do_hd_request();对于软盘操作
@@ -289,13 +313,27 @@ void ll_rw_block(int rw, struct buffer_head * bh)
 }
 
 // 块设备初始化函数,由初始化程序main.c调用.
-// 初始化请求数组,将所有请求项置为空闲项(dev = -1).有32项(NR_REQUEST = 32).
-void blk_dev_init(void)
+// 把请求数组按nr_requests[]分给各个主设备,每个设备的请求项通过next字段链成空闲链表.然后为每个主设备选择I/O调度程序:配置文件
+// deadline_majors位图里的主设备使用deadline调度程序,其余使用电梯调度程序.该位图取自引导扇区(见init/main.c),为0时使用配置文件
+// include/linux/config.h中的DEADLINE_MAJORS.
+void blk_dev_init(int deadline_majors)
 {
-	int i;
+	struct request * req = request;
+	int i, j;
 
-	for (i = 0; i < NR_REQUEST; i++) {
-		request[i].dev = -1;
-		request[i].next = NULL;
+	if (!deadline_majors)
+		deadline_majors = DEADLINE_MAJORS;
+	for (i = 0; i < NR_BLK_DEV; i++) {
+		blk_dev[i].free_request = NULL;
+		for (j = 0; j < nr_requests[i]; j++, req++) {
+			if (req >= request + NR_REQUEST)
+				panic("blk_dev_init: not enough requests");
+			req->dev = -1;
+			req->next = blk_dev[i].free_request;
+			blk_dev[i].free_request = req;
+		}
+		blk_dev[i].nr_requests = blk_dev[i].nr_free = j;
+		blk_dev[i].sched = (deadline_majors & (1 << i)) ?
+			&deadline_sched : &elevator_sched;
 	}
 }
@@ -34,6 +34,26 @@
 char	*rd_start;								// 虚拟盘在内存中的开始地址.
 int	rd_length = 0;								// 虚拟盘所占内存大小(字节).
 
+// 虚拟盘缓冲头数组.虚拟盘的每一块都有一个固定的缓冲头,其数据指针直接指向虚拟盘内存中的该块,因此虚拟盘块不占用高速缓冲区,读写也不用复制数据.
+// 该数组放在虚拟盘内存区之后,在rd_init()中初始化.
+static struct buffer_head * rd_bh = NULL;
+static int rd_blocks = 0;						// 虚拟盘块数.
+
+// 取虚拟盘块的缓冲头.
+// 若dev是虚拟盘并且块号有效,则增加该块缓冲头的引用计数并返回它,否则返回NULL(由调用者按普通设备处理).虚拟盘块的数据总是有效的.
+// 由getblk()和get_hash_table()调用.
+struct buffer_head * rd_getblk(int dev, int block)
+{
+	struct buffer_head * bh;
+
+	if (dev != 0x0101 || block < 0 || block >= rd_blocks)
+		return NULL;
+	bh = rd_bh + block;
+	bh->b_count++;
+	bh->b_uptodate = 1;
+	return bh;
+}
+
 // 虚拟盘当前请求项操作函数。
 // 该函数的程序结构与硬盘的do_hd_request()函数类似。在低级块设备接口函数ll_rw_block()建立起虚拟盘(rd)的请求项并
 // 添加到rd的链表中之后,就会调用该函数对rd当前请求项进行处理.该函数首先计算当前请求项中指定起始扇区对应虚拟盘所处内存
@@ -47,10 +67,15 @@ void do_rd_request(void)
 
 	// 首先检测请求项的合法性,若已没有请求项则退出(参见blk.h).然后计算请求项处理的虚拟盘中起始扇区在物理内存中对应的地址
 	// addr和占用的内存字节长度值len.下句用于取得请求项中的起始扇区对应的内存起始位置和内存长度.其中sector<<9表示
-	// sector * 512,换算成字节值.CURRENT被定义为(blk_dev[MAJOR_NR].current_request).
+	// sector * 512,换算成字节值.CURRENT被定义为(blk_dev[MAJOR_NR].current_request).合并后的请求项含有多个缓冲块,这里每次
+	// 只处理当前缓冲块(current_nr_sectors个扇区),end_request()会让请求项转到下一缓冲块.
 	INIT_REQUEST;
+	if (CURRENT->cmd == FLUSH) {						// 虚拟盘没有写缓存,屏障请求项直接结束.
+		end_request(1);
+		goto repeat;
+	}
 	addr = rd_start + (CURRENT->sector << 9);
-	len = CURRENT->nr_sectors << 9;
+	len = CURRENT->current_nr_sectors << 9;
 	// 如果当前请求项中子设备号不为1或者对应内存起始位置大于虚拟盘末尾，则结束该请求项，并跳转到repeat处去处理下一个虚拟
 	// 盘请求项。标号repeat定义在宏INIT_REQUEST内，位于宏的开始处，参见blk.h文件。
 	if ((MINOR(CURRENT->dev) != 1) || (addr + len > rd_start + rd_length)) {
@@ -59,7 +84,10 @@ void do_rd_request(void)
 	}
 	// 然后进行实际的读写操作。如果是写命令(WRITE)，则将请求项中缓冲区的内容复制到地址addr处，长度为len字节。如果是读命
 	// 令(READ)，则将addr开始的内存内容复制到请求项缓冲区中，长度为len字节。否则显示命令不存在，死机。
-	if (CURRENT-> cmd == WRITE) {
+	// 虚拟盘块的缓冲头数据就在虚拟盘中(addr与缓冲区相同),不需要复制.
+	if (CURRENT->buffer == addr)
+		/* nothing */ ;
+	else if (CURRENT-> cmd == WRITE) {
 		(void ) memcpy(addr,
 			      CURRENT->buffer,
 			      len);
@@ -95,7 +123,171 @@ long rd_init(long mem_start, int length)
 	// 将内存空间清零
 	for (i = 0; i < length; i++)
 		*cp++ = '\0';
-	return(length);
+	// 在虚拟盘之后建立每一块的缓冲头.缓冲头不在任何LRU链表和hash表中(b_list = BUF_RAMDISK).返回虚拟盘和缓冲头数组共占用的内存(按页面对齐).
+	rd_blocks = length / BLOCK_SIZE;
+	rd_bh = (struct buffer_head *) (rd_start + length);
+	for (i = 0; i < rd_blocks; i++) {
+		rd_bh[i].b_data = rd_start + i * BLOCK_SIZE;
+		rd_bh[i].b_blocknr = i;
+		rd_bh[i].b_dev = 0x0101;
+		rd_bh[i].b_uptodate = 1;
+		rd_bh[i].b_dirt = 0;
+		rd_bh[i].b_count = 0;
+		rd_bh[i].b_lock = 0;
+		rd_bh[i].b_list = BUF_RAMDISK;
+		rd_bh[i].b_wait = NULL;
+		rd_bh[i].b_prev = rd_bh[i].b_next = NULL;
+		rd_bh[i].b_prev_free = rd_bh[i].b_next_free = NULL;
+		rd_bh[i].b_reqnext = NULL;
+		rd_bh[i].b_inode = NULL;
+	}
+	if (!length)
+		return 0;
+	return (length + rd_blocks * sizeof(struct buffer_head) + 4095) & ~4095;
+}
+
+extern long inflate(char * dest, unsigned long len, int (*get)(void));
+
+#define GZIP_MAGIC	0x8b1f							// gzip文件头魔数(小端).
+#define GZ_FHCRC	0x02							// 头部有CRC16.
+#define GZ_FEXTRA	0x04							// 有附加字段.
+#define GZ_FNAME	0x08							// 有原文件名.
+#define GZ_FCOMMENT	0x10							// 有注释.
+
+static struct buffer_head * gz_bh;					// 当前正在读取的压缩数据块.
+static int gz_block;								// 下一个要读的盘块号.
+static int gz_pos;									// 在当前块中的读取位置.
+static unsigned long crc_table[256];
+
+/*
+ * Feed the inflater one byte at a time from the boot floppy. Blocks are
+ * read with read-ahead, so the floppy keeps streaming while we decode.
+ */
+/*
+ * 从引导软盘中逐字节地向解压程序提供数据.盘块使用breada()预读,因此在解压的同时软盘可以连续读入后面的数据.
+ */
+static int gz_getc(void)
+{
+	if (gz_pos >= BLOCK_SIZE) {
+		brelse(gz_bh);
+		gz_bh = breada(ROOT_DEV, gz_block, gz_block + 1, gz_block + 2, -1);
+		if (!gz_bh) {
+			printk("I/O error on block %d, aborting load\n", gz_block);
+			return -1;
+		}
+		gz_block++;
+		gz_pos = 0;
+	}
+	return (unsigned char) gz_bh->b_data[gz_pos++];
+}
+
+// 取一个小端格式的n字节整数.
+static long gz_getn(int n)
+{
+	long val = 0;
+	int i, c;
+
+	for (i = 0; i < n; i++) {
+		if ((c = gz_getc()) < 0)
+			return -1;
+		val |= (long) c << (i * 8);
+	}
+	return val;
+}
+
+static unsigned long crc32(unsigned char * p, unsigned long len)
+{
+	unsigned long c;
+	int n, k;
+
+	if (!crc_table[1])
+		for (n = 0; n < 256; n++) {
+			c = n;
+			for (k = 0; k < 8; k++)
+				c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			crc_table[n] = c;
+		}
+	c = 0xffffffff;
+	while (len--)
+		c = crc_table[(c ^ *p++) & 0xff] ^ (c >> 8);
+	return c ^ 0xffffffff;
+}
+
+/*
+ * Load a gzip compressed image into the ram disk. The uncompressed size
+ * is taken from an "RD" subfield in the gzip extra header, so a too big
+ * image is refused before anything is read. Images without it are
+ * decompressed up to the size of the ram disk.
+ */
+/*
+ * 把gzip压缩的映像加载到虚拟盘中.未压缩的大小取自gzip附加字段中的"RD"子字段,这样过大的映像在读入之前就会被拒绝.没有该子字段的
+ * 映像则最多解压到虚拟盘的大小.bh是已读入的映像第1块.返回0表示成功.
+ */
+static int rd_load_gzip(struct buffer_head * bh, int block)
+{
+	unsigned long size = rd_length;
+	long len, crc;
+	int flags, xlen, id, slen;
+
+	gz_bh = bh;
+	gz_block = block + 1;
+	gz_pos = 2;
+	if (gz_getc() != 8) {								// 只支持deflate压缩方式.
+		printk("Ram disk: unknown compression method\n");
+		goto out;
+	}
+	flags = gz_getc();
+	gz_getn(6);										// 跳过修改时间,XFL和OS.
+	if (flags & GZ_FEXTRA) {
+		xlen = gz_getn(2);
+		while (xlen >= 4) {
+			id = gz_getn(2);
+			slen = gz_getn(2);
+			xlen -= 4 + slen;
+			if (id == ('R' | ('D' << 8)) && slen == 4) {
+				size = gz_getn(4);
+				continue;
+			}
+			while (slen-- > 0)
+				gz_getc();
+		}
+		while (xlen-- > 0)
+			gz_getc();
+	}
+	if (flags & GZ_FNAME)
+		while (gz_getc() > 0)
+			/* nothing */;
+	if (flags & GZ_FCOMMENT)
+		while (gz_getc() > 0)
+			/* nothing */;
+	if (flags & GZ_FHCRC)
+		gz_getn(2);
+	if (size > rd_length) {
+		printk("Ram disk image too big!  (%d blocks, %d avail)\n",
+			size >> BLOCK_SIZE_BITS, rd_length >> BLOCK_SIZE_BITS);
+		goto out;
+	}
+	printk("Uncompressing %d bytes into ram disk...", size);
+	len = inflate(rd_start, size, gz_getc);
+	if (len == -1) {
+		printk("image too big!\n");
+		goto out;
+	}
+	if (len < 0) {
+		printk("bad compressed data (%d)\n", len);
+		goto out;
+	}
+	crc = gz_getn(4);
+	if (crc != crc32((unsigned char *) rd_start, len) || gz_getn(4) != len) {
+		printk("crc error\n");
+		goto out;
+	}
+	printk("done\n");
+	brelse(gz_bh);
+	return 0;
+out:
+	brelse(gz_bh);
+	return -1;
 }
 
 /*
@@ -125,6 +317,23 @@ void rd_load(void)
 	printk("Ram disk: %d bytes, starting at 0x%x, dev = 0x%x \n", rd_length, (int) rd_start, ROOT_DEV);
 	if (MAJOR(ROOT_DEV) != 2)
 		return;
+	// 先读映像的第1块.如果以gzip魔数开头,则说明是压缩映像,边读边解压到虚拟盘中,完成后检查解压出的超级块.
+	bh = breada(ROOT_DEV, block, block + 1, block + 2, -1);
+	if (!bh) {
+		printk("Disk error while looking for ramdisk!\n");
+		return;
+	}
+	if (*(unsigned short *) bh->b_data == GZIP_MAGIC) {
+		if (rd_load_gzip(bh, block))
+			return;
+		if (((struct d_super_block *) (rd_start + BLOCK_SIZE))->s_magic != SUPER_MAGIC) {
+			printk("Ram disk: no minix filesystem in compressed image\n");
+			return;
+		}
+		ROOT_DEV = 0x0101;
+		return;
+	}
+	brelse(bh);
 	// 然后读根文件系统的基本参数.即读软盘块256+1,256和256+2.这里block+1是指磁盘上的超级块.breada()用于读取指定的数据块,并标出还需要读的块,
 	// 然后返回含有数据块的缓冲区指针.如果返回NULL,则表示数据块不可读(fs/buffer.c).然后把缓冲区中的磁盘超级块(d_super_block是磁盘超级
 	// 块结构)复制到s变量中,并释放缓冲区.接着我们开始对超级块的有效性进行判断.超级块中文件系统魔数不对,则说明加载的数据块不是MINIX文件
@@ -73,7 +73,7 @@ sa_mask 	= 4						# 信号屏蔽码
 sa_flags 	= 8						# 信号集.
 sa_restorer = 12					# 恢复函数指针,参见kernel/signal.c程序说明.
 
-nr_system_calls = 82				# Linux 0.12版内核中的系统调用总数.
+nr_system_calls = 93				# 系统调用总数(sys_call_table[]的项数).
 
 ENOSYS = 38							# 系统调用号出错码.
 
@@ -9,6 +9,7 @@ system=$3
 IMAGE=$4
 root_dev=$5
 swap_dev=$6
+sched_majors=$7
 
 # Set the biggest sys_size
 SYS_SIZE=$((0x3000*16))
@@ -57,5 +58,10 @@ dd if=$system seek=5 bs=512 count=$((2888-1-4)) of=$IMAGE 2>&1 >/dev/null
 echo -ne "\x$DEFAULT_MINOR_ROOT\x$DEFAULT_MAJOR_ROOT" | dd ibs=1 obs=1 count=2 seek=508 of=$IMAGE conv=notrunc  2>&1 >/dev/null
 echo -ne "\x$DEFAULT_MINOR_SWAP\x$DEFAULT_MAJOR_SWAP" | dd ibs=1 obs=1 count=2 seek=506 of=$IMAGE conv=notrunc  2>&1 >/dev/null
 
+# Set the bitmap of majors using the deadline I/O scheduler (two hex digits), if given
+if [ -n "$sched_majors" ]; then
+	echo -ne "\x$sched_majors\x00" | dd ibs=1 obs=1 count=2 seek=504 of=$IMAGE conv=notrunc  2>&1 >/dev/null
+fi
+
 # dd bs=1024 if=root of=$IMAGE seek=256 skip=256
 